@@ -0,0 +1,79 @@
+#include "access_sampler.h"
+#include "hashers.h"
+#include <algorithm>
+
+AccessSampler::AccessSampler(int sampleRate,
+                             std::pmr::memory_resource *resource)
+    : sampleRate(std::max(sampleRate, 1)), rngState(FIBONACCI_MULTIPLIER),
+      sketch(SKETCH_WIDTH * SKETCH_DEPTH, 0, resource), candidates(resource) {
+  candidates.reserve(HEAVY_HITTERS);
+  countdown = nextCountdown();
+}
+
+// xorshift64: равномерный интервал в [1, 2 * sampleRate - 1]
+int AccessSampler::nextCountdown() {
+  if (sampleRate == 1)
+    return 1;
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return 1 + static_cast<int>(rngState % (2 * uint64_t(sampleRate) - 1));
+}
+
+void AccessSampler::record(TKey key) {
+  uint32_t estimate = UINT32_MAX;
+  for (int row = 0; row < SKETCH_DEPTH; row++) {
+    auto &counter =
+        sketch[row * SKETCH_WIDTH + reduceMask(hashWy(key, row), SKETCH_WIDTH)];
+    if (counter < UINT32_MAX)
+      counter++;
+    estimate = std::min(estimate, counter);
+  }
+
+  auto minimum = candidates.end();
+  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+    if (it->first == key) {
+      it->second = estimate;
+      return;
+    }
+    if (minimum == candidates.end() || it->second < minimum->second)
+      minimum = it;
+  }
+  if (candidates.size() < HEAVY_HITTERS)
+    candidates.emplace_back(key, estimate);
+  else if (minimum->second < estimate)
+    *minimum = {key, estimate};
+}
+
+uint32_t AccessSampler::sketchEstimate(TKey key) const {
+  uint32_t estimate = UINT32_MAX;
+  for (int row = 0; row < SKETCH_DEPTH; row++)
+    estimate = std::min(
+        estimate,
+        sketch[row * SKETCH_WIDTH + reduceMask(hashWy(key, row), SKETCH_WIDTH)]);
+  return estimate;
+}
+
+int AccessSampler::getSampleRate() const { return sampleRate; }
+
+uint64_t AccessSampler::estimate(TKey key) const {
+  return uint64_t(sketchEstimate(key)) * sampleRate;
+}
+
+std::vector<std::pair<TKey, uint64_t>> AccessSampler::topKeys(int k) const {
+  std::vector<std::pair<TKey, uint64_t>> result;
+  result.reserve(candidates.size());
+  for (auto &[key, count] : candidates)
+    result.emplace_back(key, uint64_t(sketchEstimate(key)) * sampleRate);
+  std::sort(result.begin(), result.end(), [](auto &a, auto &b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+  if (k >= 0 && result.size() > size_t(k))
+    result.resize(k);
+  return result;
+}
+
+void AccessSampler::reset() {
+  std::fill(sketch.begin(), sketch.end(), 0);
+  candidates.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "hashmap.h"
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+constexpr int SKETCH_WIDTH = 2048;
+constexpr int SKETCH_DEPTH = 4;
+constexpr int HEAVY_HITTERS = 64;
+
+// Выборочный учёт обращений: каждое ~sampleRate-е обращение попадает в
+// count-min sketch, а ключи с наибольшей оценкой держатся в списке
+// кандидатов. Интервал между выборками случайный (в среднем sampleRate),
+// чтобы периодический трафик не совпадал с шагом выборки
+class AccessSampler {
+private:
+  int sampleRate;
+  int countdown;
+  uint64_t rngState;
+  std::pmr::vector<uint32_t> sketch;
+  std::pmr::vector<std::pair<TKey, uint32_t>> candidates;
+
+  int nextCountdown();
+  void record(TKey key);
+  uint32_t sketchEstimate(TKey key) const;
+
+public:
+  explicit AccessSampler(
+      int sampleRate,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+  void sample(TKey key) {
+    if (--countdown > 0)
+      return;
+    countdown = nextCountdown();
+    record(key);
+  }
+
+  int getSampleRate() const;
+
+  // Число обращений к key, пересчитанное с учётом частоты выборки;
+  // count-min может только завысить его, но не занизить
+  uint64_t estimate(TKey key) const;
+
+  // До k самых частых ключей по убыванию оценки
+  std::vector<std::pair<TKey, uint64_t>> topKeys(int k) const;
+
+  void reset();
+};
@@ -1,5 +1,32 @@
+#include "hashers.h"
+#include "concurrent_hashmap.h"
+#include "const_hashmap.h"
+#include "durable_hashmap.h"
 #include "hashmap.h"
+#include "interned_hashmap.h"
+#include "persistent_hashmap.h"
+#include "shm_hashmap.h"
+#include "soa_hashmap.h"
+#include "slab_hashmap.h"
+#include <atomic>
 #include <benchmark/benchmark.h>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <malloc.h>
+#include <memory_resource>
+#include <random>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include <vector>
 
 constexpr size_t CAPACITY = 1 << 20;
 
@@ -123,4 +150,868 @@ static void BM_HashMap_Get_Random_Collisions(benchmark::State &state) {
 }
 BENCHMARK(BM_HashMap_Get_Random_Collisions)->RangeMultiplier(2)->Range(1 << 10, CAPACITY);
 
+enum class KeyPattern { Sequential, Strided, Random };
+
+constexpr int HASH_CAPACITY = 1 << 16;
+constexpr size_t AVALANCHE_SAMPLES = 4096;
+
+static const char *keyPatternName(KeyPattern pattern) {
+  switch (pattern) {
+  case KeyPattern::Sequential:
+    return "sequential";
+  case KeyPattern::Strided:
+    return "strided";
+  case KeyPattern::Random:
+    return "random";
+  }
+  return "unknown";
+}
+
+static std::vector<TKey> generateKeys(KeyPattern pattern, size_t count) {
+  std::vector<TKey> keys(count);
+  std::mt19937 gen(42);
+  for (size_t i = 0; i < count; i++) {
+    switch (pattern) {
+    case KeyPattern::Sequential:
+      keys[i] = static_cast<TKey>(i);
+      break;
+    case KeyPattern::Strided:
+      keys[i] = static_cast<TKey>(i * 1024);
+      break;
+    case KeyPattern::Random:
+      keys[i] = static_cast<TKey>(gen());
+      break;
+    }
+  }
+  return keys;
+}
+
+static uint64_t rawHash(HashKind kind, TKey key) {
+  switch (kind) {
+  case HashKind::Multiplicative:
+    return hashMultiplicative(key);
+  case HashKind::Murmur3:
+    return hashMurmur3(key);
+  case HashKind::Crc32c:
+    return hashCrc32c(key);
+  case HashKind::WyHash:
+    return hashWy(key, 42);
+  }
+  return 0;
+}
+
+// Средняя по всем парам (входной бит, выходной бит) величина |2 * P(flip) - 1|,
+// 0 — идеальный лавинный эффект
+static double avalancheBias(HashKind kind, const std::vector<TKey> &keys) {
+  constexpr int IN_BITS = sizeof(TKey) * 8;
+  std::vector<int> flips(IN_BITS * 64, 0);
+  size_t samples = std::min(keys.size(), AVALANCHE_SAMPLES);
+  for (size_t s = 0; s < samples; s++) {
+    uint64_t base = rawHash(kind, keys[s]);
+    for (int i = 0; i < IN_BITS; i++) {
+      uint64_t diff =
+          base ^ rawHash(kind, static_cast<TKey>(keys[s] ^ (1u << i)));
+      for (int j = 0; j < 64; j++)
+        flips[i * 64 + j] += (diff >> j) & 1;
+    }
+  }
+  double bias = 0;
+  for (int f : flips)
+    bias += std::abs(2.0 * f / samples - 1.0);
+  return bias / flips.size();
+}
+
+static void BM_Hash(benchmark::State &state) {
+  auto kind = static_cast<HashKind>(state.range(0));
+  auto reduction = static_cast<Reduction>(state.range(1));
+  auto pattern = static_cast<KeyPattern>(state.range(2));
+  auto hf = makeHashFunction(kind, reduction, 42);
+  auto keys = generateKeys(pattern, HASH_CAPACITY);
+
+  for (auto _ : state) {
+    int acc = 0;
+    for (TKey key : keys)
+      acc += hf(key, HASH_CAPACITY);
+    benchmark::DoNotOptimize(acc);
+  }
+
+  std::vector<int> chains(HASH_CAPACITY, 0);
+  for (TKey key : keys)
+    chains[hf(key, HASH_CAPACITY)]++;
+  double mean = double(keys.size()) / HASH_CAPACITY;
+  double variance = 0;
+  for (int length : chains)
+    variance += (length - mean) * (length - mean);
+  variance /= HASH_CAPACITY;
+
+  state.SetLabel(std::string(hashKindName(kind)) + "/" +
+                 reductionName(reduction) + "/" + keyPatternName(pattern));
+  state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+  state.counters["hash_time"] = benchmark::Counter(
+      keys.size(), benchmark::Counter::kIsIterationInvariantRate |
+                       benchmark::Counter::kInvert);
+  state.counters["chain_var"] = variance;
+  state.counters["max_chain"] = *std::max_element(chains.begin(), chains.end());
+  state.counters["avalanche"] = avalancheBias(kind, keys);
+}
+// kind x reduction x pattern; при нагрузке 1.0 идеальная дисперсия цепочек ~1
+BENCHMARK(BM_Hash)->ArgsProduct({{0, 1, 2, 3}, {0, 1}, {0, 1, 2}});
+
+constexpr int LAYOUT_CAPACITY = 1 << 17;
+
+static size_t heapInUse() {
+  auto info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+// Сравнение хранения значений: std::string в узле (HashMap) и слэб (SlabHashMap)
+template <typename Map> static void BM_Layout_Memory(benchmark::State &state) {
+  double bytesPerEntry = 0;
+  for (auto _ : state) {
+    size_t before = heapInUse();
+    {
+      Map map(LAYOUT_CAPACITY);
+      for (int i = 0; i < state.range(0); i++) {
+        map.set(i, std::string(1000, 'a') + std::to_string(i));
+      }
+      bytesPerEntry = double(heapInUse() - before) / state.range(0);
+    }
+  }
+  state.counters["bytes_per_entry"] = bytesPerEntry;
+}
+BENCHMARK_TEMPLATE(BM_Layout_Memory, HashMap)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY)->Iterations(1);
+BENCHMARK_TEMPLATE(BM_Layout_Memory, SlabHashMap)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY)->Iterations(1);
+
+template <typename Map> static void BM_Layout_Set(benchmark::State &state) {
+  Map map(LAYOUT_CAPACITY);
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      map.set(i, std::string(1000, 'a') + std::to_string(i));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Layout_Set, HashMap)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY);
+BENCHMARK_TEMPLATE(BM_Layout_Set, SlabHashMap)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY);
+
+template <typename Map> static void BM_Layout_Get(benchmark::State &state) {
+  Map map(LAYOUT_CAPACITY);
+  for (int i = 0; i < state.range(0); i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      benchmark::DoNotOptimize(map.get(i));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Layout_Get, HashMap)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY);
+BENCHMARK_TEMPLATE(BM_Layout_Get, SlabHashMap)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY);
+
+// Перезапись половины ключей с фоновой компакцией: след памяти после уборки
+static void BM_Slab_Overwrite_Compaction(benchmark::State &state) {
+  SlabHashMap map(LAYOUT_CAPACITY);
+  map.startBackgroundCompaction(0.5);
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      map.set(i % (state.range(0) / 2), std::string(1000, 'b') + std::to_string(i));
+    }
+  }
+  map.stopBackgroundCompaction();
+  map.compact(0.0);
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+  state.counters["slab_bytes"] = map.getSlabBytes();
+  state.counters["live_bytes"] = map.getLiveBytes();
+}
+BENCHMARK(BM_Slab_Overwrite_Compaction)->RangeMultiplier(4)->Range(1 << 10, LAYOUT_CAPACITY);
+
+static const THashFunction SCENARIOS[] = {CACHE_NO_COLLISIONS, CACHE_MANY_COLLISIONS,
+                                          CACHE_RANDOM_COLLISIONS};
+
+// Вставка исходных данных (range(1): 0 - без коллизий, 1 - много, 2 - случайные)
+// с замером занятой кучи после заполнения
+template <typename Map> static void BM_Intern_Set(benchmark::State &state) {
+  double bytesPerEntry = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    size_t before = heapInUse();
+    auto map = std::make_unique<Map>(CAPACITY, SCENARIOS[state.range(1)]);
+    state.ResumeTiming();
+    for (int i = 0; i < state.range(0); i++) {
+      map->set(i, std::string(1000, 'a') + std::to_string(i));
+    }
+    state.PauseTiming();
+    bytesPerEntry = double(heapInUse() - before) / state.range(0);
+    if constexpr (std::is_same_v<Map, InternedHashMap>) {
+      state.counters["logical_bytes"] = map->getLogicalBytes();
+      state.counters["stored_bytes"] = map->getStoredBytes();
+    }
+    map.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+  state.counters["bytes_per_entry"] = bytesPerEntry;
+}
+BENCHMARK_TEMPLATE(BM_Intern_Set, HashMap)->ArgsProduct({{1 << 12, 1 << 16, 1 << 18}, {0, 1, 2}});
+BENCHMARK_TEMPLATE(BM_Intern_Set, InternedHashMap)->ArgsProduct({{1 << 12, 1 << 16, 1 << 18}, {0, 1, 2}});
+
+template <typename Map> static void BM_Intern_Get(benchmark::State &state) {
+  Map map(CAPACITY, SCENARIOS[state.range(1)]);
+  for (int i = 0; i < state.range(0); i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      benchmark::DoNotOptimize(map.get(i));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Intern_Get, HashMap)->ArgsProduct({{1 << 12, 1 << 16}, {0, 1, 2}});
+BENCHMARK_TEMPLATE(BM_Intern_Get, InternedHashMap)->ArgsProduct({{1 << 12, 1 << 16}, {0, 1, 2}});
+
+constexpr int SNAPSHOT_CAPACITY = 1 << 18;
+
+static void BM_Snapshot_Create(benchmark::State &state) {
+  PersistentHashMap map(SNAPSHOT_CAPACITY);
+  for (int i = 0; i < state.range(0); i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.snapshot());
+  }
+}
+BENCHMARK(BM_Snapshot_Create)->RangeMultiplier(4)->Range(1 << 10, SNAPSHOT_CAPACITY);
+
+// Полная копия HashMap — то, чем снапшот заменяет долгие чтения
+static void BM_Snapshot_DeepCopy_Baseline(benchmark::State &state) {
+  HashMap map(SNAPSHOT_CAPACITY);
+  for (int i = 0; i < state.range(0); i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  for (auto _ : state) {
+    HashMap copy(SNAPSHOT_CAPACITY);
+    for (int i = 0; i < state.range(0); i++) {
+      copy.set(i, *map.get(i));
+    }
+    benchmark::DoNotOptimize(copy.getSize());
+  }
+}
+BENCHMARK(BM_Snapshot_DeepCopy_Baseline)->RangeMultiplier(4)->Range(1 << 10, SNAPSHOT_CAPACITY);
+
+// Писатель перезаписывает ключи, каждые 4096 записей берётся новый снапшот,
+// а самый старый отпускается; range(0) — сколько снапшотов живут одновременно
+static void BM_Snapshot_Writer(benchmark::State &state) {
+  constexpr int KEYS = 1 << 16;
+  constexpr int WRITES_PER_SNAPSHOT = 4096;
+  PersistentHashMap map(SNAPSHOT_CAPACITY);
+  for (int i = 0; i < KEYS; i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  std::deque<std::shared_ptr<const HashMapSnapshot>> live;
+  std::mt19937 gen(42);
+  for (auto _ : state) {
+    for (int i = 0; i < WRITES_PER_SNAPSHOT; i++) {
+      map.set(gen() % KEYS, std::string(1000, 'b') + std::to_string(i));
+    }
+    if (state.range(0) > 0) {
+      live.push_back(map.snapshot());
+      if (live.size() > size_t(state.range(0)))
+        live.pop_front();
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * WRITES_PER_SNAPSHOT);
+}
+BENCHMARK(BM_Snapshot_Writer)->DenseRange(0, 8);
+
+constexpr int SHM_KEYS = 1 << 16;
+constexpr uint64_t SHM_SEGMENT_SIZE = 1ull << 30;
+const std::string SHM_NAME = "/hashmap_bench";
+
+static void fillShm(ShmHashMap &map) {
+  for (int i = 0; i < SHM_KEYS; i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+}
+
+static void BM_Shm_Get(benchmark::State &state) {
+  ShmHashMap map(SHM_NAME, SHM_KEYS, SHM_SEGMENT_SIZE);
+  fillShm(map);
+  for (auto _ : state) {
+    for (int i = 0; i < SHM_KEYS; i++) {
+      benchmark::DoNotOptimize(map.get(i));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * SHM_KEYS);
+  ShmHashMap::unlink(SHM_NAME);
+}
+BENCHMARK(BM_Shm_Get);
+
+// Стоимость старта процесса: подключение к готовому сегменту против
+// построения собственной копии HashMap
+static void BM_Shm_Attach(benchmark::State &state) {
+  ShmHashMap owner(SHM_NAME, SHM_KEYS, SHM_SEGMENT_SIZE);
+  fillShm(owner);
+  for (auto _ : state) {
+    ShmHashMap attached(SHM_NAME);
+    benchmark::DoNotOptimize(attached.getSize());
+  }
+  ShmHashMap::unlink(SHM_NAME);
+}
+BENCHMARK(BM_Shm_Attach);
+
+static void BM_Shm_Build_Private_Copy(benchmark::State &state) {
+  for (auto _ : state) {
+    HashMap map(SHM_KEYS);
+    for (int i = 0; i < SHM_KEYS; i++) {
+      map.set(i, std::string(1000, 'a') + std::to_string(i));
+    }
+    benchmark::DoNotOptimize(map.getSize());
+  }
+}
+BENCHMARK(BM_Shm_Build_Private_Copy)->Unit(benchmark::kMillisecond);
+
+struct ShmReaderStats {
+  std::atomic<bool> stop;
+  std::atomic<uint64_t> reads[64];
+};
+
+// Один писатель (этот процесс) и range(0) читателей, запущенных через fork
+static void BM_Shm_MultiProcess(benchmark::State &state) {
+  int readers = state.range(0);
+  ShmHashMap map(SHM_NAME, SHM_KEYS, SHM_SEGMENT_SIZE);
+  fillShm(map);
+  auto stats = static_cast<ShmReaderStats *>(
+      mmap(nullptr, sizeof(ShmReaderStats), PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  new (stats) ShmReaderStats{};
+
+  std::vector<pid_t> children;
+  for (int r = 0; r < readers; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      ShmHashMap reader(SHM_NAME);
+      std::mt19937 gen(r);
+      uint64_t reads = 0;
+      while (!stats->stop.load(std::memory_order_relaxed)) {
+        benchmark::DoNotOptimize(reader.get(gen() % SHM_KEYS));
+        reads++;
+      }
+      stats->reads[r].store(reads);
+      _exit(0);
+    }
+    children.push_back(pid);
+  }
+
+  std::mt19937 gen(42);
+  auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    map.set(gen() % SHM_KEYS, std::string(1000, 'b'));
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats->stop.store(true);
+  uint64_t totalReads = 0;
+  for (int r = 0; r < readers; r++) {
+    waitpid(children[r], nullptr, 0);
+    totalReads += stats->reads[r].load();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["reads_per_second"] = totalReads / seconds;
+  munmap(stats, sizeof(ShmReaderStats));
+  ShmHashMap::unlink(SHM_NAME);
+}
+BENCHMARK(BM_Shm_MultiProcess)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+constexpr int SMALL_MAPS = 4096;
+constexpr int SMALL_MAP_CAPACITY = 64;
+
+// range(0) — пар в каждой таблице, range(1) — 1, если бакеты выделяются сразу
+// (раскладка до появления inline-режима)
+static std::vector<std::unique_ptr<HashMap>> makeSmallMaps(int pairs, bool eager) {
+  std::vector<std::unique_ptr<HashMap>> maps;
+  maps.reserve(SMALL_MAPS);
+  for (int m = 0; m < SMALL_MAPS; m++) {
+    auto map = std::make_unique<HashMap>(SMALL_MAP_CAPACITY);
+    if (eager)
+      map->reserveBuckets();
+    for (int i = 0; i < pairs; i++) {
+      TVal value = std::to_string(i);
+      value.insert(0, 1, 'v');
+      map->set(i * 7919, std::move(value));
+    }
+    maps.push_back(std::move(map));
+  }
+  return maps;
+}
+
+static void BM_SmallMap_Memory(benchmark::State &state) {
+  double bytesPerMap = 0;
+  for (auto _ : state) {
+    size_t before = heapInUse();
+    auto maps = makeSmallMaps(state.range(0), state.range(1));
+    bytesPerMap = double(heapInUse() - before) / SMALL_MAPS;
+  }
+  state.counters["bytes_per_map"] = bytesPerMap;
+  state.SetLabel(state.range(1) ? "eager" : "inline");
+}
+BENCHMARK(BM_SmallMap_Memory)->ArgsProduct({{0, 1, 2, 4, 8, 16, 32, 64}, {0, 1}})->Iterations(1);
+
+static void BM_SmallMap_Get(benchmark::State &state) {
+  int pairs = state.range(0);
+  auto maps = makeSmallMaps(pairs, state.range(1));
+  std::mt19937 gen(42);
+  std::vector<std::pair<int, TKey>> lookups(1 << 16);
+  for (auto &[map, key] : lookups) {
+    map = gen() % SMALL_MAPS;
+    key = pairs ? int(gen() % pairs) * 7919 : 1;
+  }
+  for (auto _ : state) {
+    for (auto &[map, key] : lookups) {
+      benchmark::DoNotOptimize(maps[map]->get(key));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * lookups.size());
+  state.SetLabel(state.range(1) ? "eager" : "inline");
+}
+BENCHMARK(BM_SmallMap_Get)->ArgsProduct({{0, 1, 2, 4, 8, 16, 32, 64}, {0, 1}});
+
+// Аппаратный счётчик perf для одного потока; если perf_event недоступен
+// (контейнер, macOS, perf_event_paranoid), счётчик просто не сообщается
+class PerfCounter {
+private:
+  int fd = -1;
+
+public:
+  PerfCounter(uint32_t type, uint64_t config) {
+#if defined(__linux__)
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+
+  ~PerfCounter() {
+    if (fd >= 0)
+      close(fd);
+  }
+
+  PerfCounter(const PerfCounter &) = delete;
+  PerfCounter &operator=(const PerfCounter &) = delete;
+
+  bool valid() const { return fd >= 0; }
+
+  void start() {
+#if defined(__linux__)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t stop() {
+    uint64_t value = 0;
+#if defined(__linux__)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &value, sizeof(value)) != sizeof(value))
+        value = 0;
+    }
+#endif
+    return value;
+  }
+};
+
+#if defined(__linux__)
+constexpr uint32_t L1D_MISS_TYPE = PERF_TYPE_HW_CACHE;
+constexpr uint64_t L1D_MISS_CONFIG = PERF_COUNT_HW_CACHE_L1D |
+                                     (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+constexpr uint32_t LLC_MISS_TYPE = PERF_TYPE_HARDWARE;
+constexpr uint64_t LLC_MISS_CONFIG = PERF_COUNT_HW_CACHE_MISSES;
+#else
+constexpr uint32_t L1D_MISS_TYPE = 0;
+constexpr uint64_t L1D_MISS_CONFIG = 0;
+constexpr uint32_t LLC_MISS_TYPE = 0;
+constexpr uint64_t LLC_MISS_CONFIG = 0;
+#endif
+
+// Сценарии Get из начала файла (range(1): 0 - без коллизий, 1 - много, 2 - случайные)
+// для узловой (HashMap) и SoA раскладки, с промахами L1/LLC на один поиск
+template <typename Map> static void BM_Get_Cache(benchmark::State &state) {
+  Map map(CAPACITY, SCENARIOS[state.range(1)]);
+  for (int i = 0; i < state.range(0); i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  PerfCounter l1(L1D_MISS_TYPE, L1D_MISS_CONFIG);
+  PerfCounter llc(LLC_MISS_TYPE, LLC_MISS_CONFIG);
+  l1.start();
+  llc.start();
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      benchmark::DoNotOptimize(map.get(i));
+    }
+  }
+  uint64_t l1Count = l1.stop();
+  uint64_t llcCount = llc.stop();
+  double lookups = double(state.iterations()) * state.range(0);
+  state.SetItemsProcessed(int64_t(lookups));
+  if (l1.valid())
+    state.counters["L1d_miss"] = l1Count / lookups;
+  if (llc.valid())
+    state.counters["LLC_miss"] = llcCount / lookups;
+}
+BENCHMARK_TEMPLATE(BM_Get_Cache, HashMap)->ArgsProduct({{1 << 10, 1 << 14, 1 << 18, 1 << 20}, {0, 1, 2}});
+BENCHMARK_TEMPLATE(BM_Get_Cache, SoAHashMap)->ArgsProduct({{1 << 10, 1 << 14, 1 << 18, 1 << 20}, {0, 1, 2}});
+
+// Масштабирование массовых операций от 1 потока до всех аппаратных
+static void ParallelThreads(benchmark::internal::Benchmark *b) {
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads = 1; threads < maxThreads; threads *= 2)
+    b->Arg(threads);
+  b->Arg(maxThreads);
+}
+
+constexpr int PARALLEL_ITEMS = 1 << 20;
+
+static std::vector<std::pair<TKey, TVal>> makeParallelItems() {
+  std::vector<std::pair<TKey, TVal>> items;
+  items.reserve(PARALLEL_ITEMS);
+  for (int i = 0; i < PARALLEL_ITEMS; i++)
+    items.emplace_back(i, std::to_string(i));
+  return items;
+}
+
+static void BM_Parallel_Build(benchmark::State &state) {
+  auto items = makeParallelItems();
+  for (auto _ : state) {
+    HashMap map(PARALLEL_ITEMS);
+    map.parallelBuild(items, state.range(0));
+    benchmark::DoNotOptimize(map.getSize());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * PARALLEL_ITEMS);
+}
+BENCHMARK(BM_Parallel_Build)->Apply(ParallelThreads)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_Sequential_Build(benchmark::State &state) {
+  auto items = makeParallelItems();
+  for (auto _ : state) {
+    HashMap map(PARALLEL_ITEMS);
+    for (auto &[key, value] : items)
+      map.set(key, value);
+    benchmark::DoNotOptimize(map.getSize());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * PARALLEL_ITEMS);
+}
+BENCHMARK(BM_Sequential_Build)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_Parallel_ForEach(benchmark::State &state) {
+  HashMap map(PARALLEL_ITEMS);
+  map.parallelBuild(makeParallelItems(), 0);
+  std::atomic<size_t> total{0};
+  for (auto _ : state) {
+    map.parallelForEach(
+        [&total](TKey, TVal &value) {
+          total.fetch_add(value.size(), std::memory_order_relaxed);
+        },
+        state.range(0));
+  }
+  benchmark::DoNotOptimize(total.load());
+  state.SetItemsProcessed(int64_t(state.iterations()) * PARALLEL_ITEMS);
+}
+BENCHMARK(BM_Parallel_ForEach)->Apply(ParallelThreads)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_Parallel_Rehash(benchmark::State &state) {
+  HashMap map(PARALLEL_ITEMS / 2);
+  map.parallelBuild(makeParallelItems(), 0);
+  int capacity = PARALLEL_ITEMS;
+  for (auto _ : state) {
+    map.parallelRehash(capacity, state.range(0));
+    capacity = capacity == PARALLEL_ITEMS ? PARALLEL_ITEMS / 2 : PARALLEL_ITEMS;
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * PARALLEL_ITEMS);
+}
+BENCHMARK(BM_Parallel_Rehash)->Apply(ParallelThreads)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Полный обход таблицы: итератором и через scan порциями по range(1)
+static void BM_Full_Scan_Iterator(benchmark::State &state) {
+  HashMap map(CAPACITY);
+  for (int i = 0; i < state.range(0); i++)
+    map.set(i, std::to_string(i));
+  for (auto _ : state) {
+    size_t total = 0;
+    for (auto [key, value] : map)
+      total += key + value.size();
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Full_Scan_Iterator)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static void BM_Full_Scan_Cursor(benchmark::State &state) {
+  HashMap map(CAPACITY);
+  for (int i = 0; i < state.range(0); i++)
+    map.set(i, std::to_string(i));
+  for (auto _ : state) {
+    size_t total = 0;
+    uint64_t cursor = 0;
+    do {
+      cursor = map.scan(cursor, state.range(1), [&total](TKey key, const TVal &value) {
+        total += key + value.size();
+      });
+    } while (cursor != 0);
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Full_Scan_Cursor)->ArgsProduct({{1 << 10, 1 << 14, 1 << 18, 1 << 22}, {16, 1024}});
+
+// Накладные расходы учёта горячих ключей на сценариях Get:
+// range(0) - сценарий, range(1) - частота выборки (0 - учёт выключен)
+static void BM_Get_Sampled(benchmark::State &state) {
+  constexpr int KEYS = 1 << 16;
+  HashMap map(CAPACITY, SCENARIOS[state.range(0)]);
+  for (int i = 0; i < KEYS; i++) {
+    map.set(i, std::string(1000, 'a') + std::to_string(i));
+  }
+  if (state.range(1) > 0)
+    map.enableSampling(state.range(1));
+  for (auto _ : state) {
+    for (int i = 0; i < KEYS; i++) {
+      benchmark::DoNotOptimize(map.get(i));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * KEYS);
+}
+BENCHMARK(BM_Get_Sampled)->ArgsProduct({{0, 1, 2}, {0, 1, 16, 256, 4096}});
+
+// DurableHashMap: пропускная способность set при разном окне группового
+// коммита (range(0) операций на один fdatasync)
+static std::string durablePath(const char *name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static void BM_Durable_Set(benchmark::State &state) {
+  std::string path = durablePath("hashmap_bench_durable");
+  DurableHashMap::unlink(path);
+  DurableHashMap map(path, CAPACITY, state.range(0));
+  TVal value(100, 'v');
+  int key = 0;
+  for (auto _ : state) {
+    map.set(key++ & (CAPACITY - 1), value);
+  }
+  map.sync();
+  state.SetItemsProcessed(state.iterations());
+  state.counters["log_MB"] = map.getLogBytes() / double(1 << 20);
+  DurableHashMap::unlink(path);
+}
+BENCHMARK(BM_Durable_Set)->Arg(1)->Arg(8)->Arg(64)->Arg(512)->Arg(4096)->UseRealTime();
+
+// Восстановление после 10M операций над 1M ключей. range(0): 0 - каждая
+// десятая операция remove (серии SET короче пачки replay, всё идёт через
+// set), 1 - remove раз в 1M операций (длинные серии, parallelBuild),
+// 2 - те же 10M операций сохранены checkpoint(), в логе ещё 1M поверх снапшота
+constexpr int RECOVERY_OPS = 10'000'000;
+constexpr int RECOVERY_KEYS = 1 << 20;
+
+static void BM_Durable_Recovery(benchmark::State &state) {
+  std::string path = durablePath("hashmap_bench_recovery");
+  DurableHashMap::unlink(path);
+  int removeEvery = state.range(0) == 1 ? 1'000'000 : 10;
+  int64_t replayed = 0;
+  {
+    DurableHashMap map(path, RECOVERY_KEYS, 1 << 16);
+    std::mt19937 rng(42);
+    TVal value(16, 'r');
+    auto run = [&](int ops) {
+      for (int i = 0; i < ops; i++) {
+        TKey key = rng() % RECOVERY_KEYS;
+        if (i % removeEvery == removeEvery - 1)
+          map.remove(key);
+        else
+          map.set(key, value);
+      }
+    };
+    run(RECOVERY_OPS);
+    replayed = RECOVERY_OPS;
+    if (state.range(0) == 2) {
+      map.checkpoint();
+      replayed = map.getSize();
+      run(RECOVERY_OPS / 10);
+      replayed += RECOVERY_OPS / 10;
+    }
+    map.sync();
+  }
+  uint64_t logBytes = std::filesystem::file_size(path + ".wal");
+  if (std::filesystem::exists(path + ".snapshot"))
+    logBytes += std::filesystem::file_size(path + ".snapshot");
+  for (auto _ : state) {
+    DurableHashMap map(path, RECOVERY_KEYS, 1 << 16);
+    benchmark::DoNotOptimize(map.getSize());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * replayed);
+  state.SetBytesProcessed(int64_t(state.iterations()) * logBytes);
+  DurableHashMap::unlink(path);
+}
+BENCHMARK(BM_Durable_Recovery)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(3);
+
+// Churn (вставка и удаление range(1) ключей) при разных memory_resource
+// для узлов и бакетов: 0 - по умолчанию, 1 - monotonic, 2 - unsynchronized_pool
+static void BM_Churn_Resource(benchmark::State &state) {
+  std::unique_ptr<std::pmr::memory_resource> resource;
+  if (state.range(0) == 1)
+    resource = std::make_unique<std::pmr::monotonic_buffer_resource>();
+  else if (state.range(0) == 2)
+    resource = std::make_unique<std::pmr::unsynchronized_pool_resource>();
+  for (auto _ : state) {
+    {
+      HashMap map(CAPACITY, resource ? resource.get() : std::pmr::get_default_resource());
+      for (int i = 0; i < state.range(1); i++)
+        map.set(i, std::to_string(i));
+      for (int i = 0; i < state.range(1); i++)
+        map.remove(i);
+      benchmark::DoNotOptimize(map.getSize());
+    }
+    state.PauseTiming();
+    // monotonic освобождает память только целиком
+    if (state.range(0) == 1)
+      static_cast<std::pmr::monotonic_buffer_resource *>(resource.get())->release();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(1) * 2);
+}
+BENCHMARK(BM_Churn_Resource)->ArgsProduct({{0, 1, 2}, {1 << 12, 1 << 16}});
+
+// Статические таблицы: ConstHashMap, построенный при компиляции, против
+// HashMap, заполняемого при старте. Ключи разрежены, значения короткие
+static constexpr std::string_view STATIC_VALUES[] = {
+    "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta"};
+
+constexpr TKey staticKey(size_t i) { return static_cast<TKey>(i * 7919); }
+
+template <size_t N> consteval std::array<TConstEntry, N> staticEntries() {
+  std::array<TConstEntry, N> entries{};
+  for (size_t i = 0; i < N; i++)
+    entries[i] = {staticKey(i), STATIC_VALUES[i % 8]};
+  return entries;
+}
+
+template <size_t N>
+constexpr auto STATIC_TABLE = makeConstHashMap([] { return staticEntries<N>(); });
+
+// Ключи берутся из памяти, чтобы компилятор не свернул поиск в константу
+static std::vector<TKey> staticKeys(size_t n) {
+  std::vector<TKey> keys(n);
+  for (size_t i = 0; i < n; i++)
+    keys[i] = staticKey(i);
+  return keys;
+}
+
+static void fillStatic(HashMap &map, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    map.set(staticKey(i), TVal(STATIC_VALUES[i % 8]));
+}
+
+template <size_t N> static void BM_Static_Get_Const(benchmark::State &state) {
+  auto keys = staticKeys(N);
+  for (auto _ : state) {
+    for (TKey key : keys)
+      benchmark::DoNotOptimize(STATIC_TABLE<N>.get(key));
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * N);
+  state.counters["rodata_KB"] = sizeof(STATIC_TABLE<N>) / 1024.0;
+}
+
+template <size_t N> static void BM_Static_Get_Runtime(benchmark::State &state) {
+  auto keys = staticKeys(N);
+  HashMap map(N);
+  fillStatic(map, N);
+  for (auto _ : state) {
+    for (TKey key : keys)
+      benchmark::DoNotOptimize(map.get(key));
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * N);
+}
+
+// Цена старта: столько стоит заполнить HashMap при запуске программы;
+// ConstHashMap на старте ничего не делает (таблица уже в .rodata)
+template <size_t N> static void BM_Static_Startup_Runtime(benchmark::State &state) {
+  for (auto _ : state) {
+    HashMap map(N);
+    fillStatic(map, N);
+    benchmark::DoNotOptimize(map.getSize());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * N);
+}
+
+BENCHMARK_TEMPLATE(BM_Static_Get_Const, 64);
+BENCHMARK_TEMPLATE(BM_Static_Get_Const, 1024);
+BENCHMARK_TEMPLATE(BM_Static_Get_Const, 16384);
+BENCHMARK_TEMPLATE(BM_Static_Get_Const, 65536);
+BENCHMARK_TEMPLATE(BM_Static_Get_Runtime, 64);
+BENCHMARK_TEMPLATE(BM_Static_Get_Runtime, 1024);
+BENCHMARK_TEMPLATE(BM_Static_Get_Runtime, 16384);
+BENCHMARK_TEMPLATE(BM_Static_Get_Runtime, 65536);
+BENCHMARK_TEMPLATE(BM_Static_Startup_Runtime, 64);
+BENCHMARK_TEMPLATE(BM_Static_Startup_Runtime, 1024);
+BENCHMARK_TEMPLATE(BM_Static_Startup_Runtime, 16384);
+BENCHMARK_TEMPLATE(BM_Static_Startup_Runtime, 65536);
+
+// WriteBatch против отдельных set при двух фоновых читателях:
+// range(0) - размер пачки, range(1) - 1 пачкой, 0 по одной операции
+constexpr int BATCH_KEYS = 1 << 16;
+
+static void BM_Concurrent_Write(benchmark::State &state) {
+  ConcurrentHashMap map(BATCH_KEYS);
+  for (int i = 0; i < BATCH_KEYS; i++)
+    map.set(i, std::to_string(i));
+  std::atomic<bool> stop{false};
+  std::atomic<int64_t> reads{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; r++) {
+    readers.emplace_back([&map, &stop, &reads, r]() {
+      std::mt19937 rng(r);
+      int64_t local = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        benchmark::DoNotOptimize(map.get(rng() % BATCH_KEYS));
+        local++;
+      }
+      reads += local;
+    });
+  }
+
+  std::mt19937 rng(42);
+  TVal value(32, 'w');
+  WriteBatch batch;
+  for (auto _ : state) {
+    if (state.range(1)) {
+      batch.clear();
+      for (int i = 0; i < state.range(0); i++)
+        batch.put(rng() % BATCH_KEYS, value);
+      map.write(batch);
+    } else {
+      for (int i = 0; i < state.range(0); i++)
+        map.set(rng() % BATCH_KEYS, value);
+    }
+  }
+  stop = true;
+  for (auto &reader : readers)
+    reader.join();
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+  state.counters["reads"] = benchmark::Counter(reads, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Concurrent_Write)->ArgsProduct({{1, 16, 256, 4096}, {0, 1}})->UseRealTime();
+
 BENCHMARK_MAIN(); // <-- генерирует main автоматически
@@ -0,0 +1,108 @@
+#include "concurrent_hashmap.h"
+#include "hashers.h"
+#include <algorithm>
+#include <mutex>
+
+ConcurrentHashMap::ConcurrentHashMap(int capacity, WriteAheadLog *wal)
+    : wal(wal) {
+  shards.reserve(CONCURRENT_SHARDS);
+  for (int i = 0; i < CONCURRENT_SHARDS; i++)
+    shards.push_back(std::make_unique<Shard>(
+        std::max(roundCapacity(capacity) / CONCURRENT_SHARDS, 1)));
+}
+
+// Бакет внутри шарда выбирается старшими битами хэша по Фибоначчи,
+// поэтому шард берётся из младших бит другого хэша, иначе все ключи шарда
+// легли бы в одну долю его бакетов
+int ConcurrentHashMap::shardOf(TKey key) {
+  return reduceMask(hashMurmur3(key), CONCURRENT_SHARDS);
+}
+
+std::optional<TVal> ConcurrentHashMap::remove(TKey key) {
+  auto &shard = *shards[shardOf(key)];
+  std::optional<TVal> value;
+  uint64_t lsn = 0;
+  {
+    std::unique_lock guard(shard.lock);
+    value = shard.map.remove(key);
+    if (value && wal)
+      lsn = wal->append(WalOp::Remove, key);
+  }
+  if (lsn)
+    wal->sync(lsn);
+  return value;
+}
+
+bool ConcurrentHashMap::has(TKey key) {
+  auto &shard = *shards[shardOf(key)];
+  std::shared_lock guard(shard.lock);
+  return shard.map.has(key);
+}
+
+void ConcurrentHashMap::set(TKey key, TVal val) {
+  auto &shard = *shards[shardOf(key)];
+  uint64_t lsn = 0;
+  {
+    std::unique_lock guard(shard.lock);
+    if (wal)
+      lsn = wal->append(WalOp::Set, key, val);
+    shard.map.set(key, std::move(val));
+  }
+  if (lsn)
+    wal->sync(lsn);
+}
+
+int ConcurrentHashMap::getSize() {
+  int size = 0;
+  for (auto &shard : shards) {
+    std::shared_lock guard(shard->lock);
+    size += shard->map.getSize();
+  }
+  return size;
+}
+
+std::optional<TVal> ConcurrentHashMap::get(TKey key) {
+  auto &shard = *shards[shardOf(key)];
+  std::shared_lock guard(shard.lock);
+  return shard.map.get(key);
+}
+
+void ConcurrentHashMap::write(const WriteBatch &batch) {
+  if (batch.empty())
+    return;
+  auto &ops = batch.getOps();
+
+  // Ключ сортировки: шард в старших 32 битах, бакет в младших; индекс
+  // операции вторым полем сохраняет порядок изменений одного ключа
+  std::vector<std::pair<uint64_t, uint32_t>> order(ops.size());
+  for (size_t i = 0; i < ops.size(); i++) {
+    int shard = shardOf(ops[i].key);
+    int bucket = reduceFibonacci(static_cast<uint32_t>(ops[i].key),
+                                 shards[shard]->map.getCapacity());
+    order[i] = {(uint64_t(shard) << 32) | uint32_t(bucket), uint32_t(i)};
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<std::unique_lock<std::shared_mutex>> locks;
+  for (auto &[position, index] : order) {
+    int shard = position >> 32;
+    if (locks.empty() || locks.back().mutex() != &shards[shard]->lock)
+      locks.emplace_back(shards[shard]->lock);
+  }
+
+  uint64_t lsn = 0;
+  if (wal)
+    lsn = wal->append(batch);
+  for (auto &[position, index] : order) {
+    auto &op = ops[index];
+    auto &map = shards[position >> 32]->map;
+    if (op.op == WalOp::Set)
+      map.set(op.key, op.value);
+    else
+      map.remove(op.key);
+  }
+  locks.clear();
+
+  if (lsn)
+    wal->sync(lsn);
+}
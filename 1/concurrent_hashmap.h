@@ -0,0 +1,53 @@
+#pragma once
+
+#include "hashmap.h"
+#include "wal.h"
+#include "write_batch.h"
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+constexpr int CONCURRENT_SHARDS = 16;
+
+// Потокобезопасная хэш-таблица из CONCURRENT_SHARDS независимых HashMap,
+// каждая под своим shared_mutex. Читатели берут разделяемую блокировку
+// шарда, писатели - исключительную. Если передан WAL, каждое изменение
+// пишется в него под блокировкой шарда (порядок в логе совпадает с порядком
+// применения) и дожидается fdatasync уже после её снятия, поэтому
+// одновременные писатели делят один групповой коммит
+class ConcurrentHashMap {
+private:
+  struct alignas(64) Shard {
+    std::shared_mutex lock;
+    HashMap map;
+
+    explicit Shard(int capacity) : map(capacity) { map.reserveBuckets(); }
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  WriteAheadLog *wal;
+
+  static int shardOf(TKey key);
+
+public:
+  explicit ConcurrentHashMap(int capacity, WriteAheadLog *wal = nullptr);
+
+  ConcurrentHashMap(const ConcurrentHashMap &) = delete;
+  ConcurrentHashMap &operator=(const ConcurrentHashMap &) = delete;
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, TVal val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+
+  // Применяет batch атомарно: операции сортируются по (шард, бакет),
+  // затронутые шарды блокируются по одному разу в порядке возрастания
+  // номера (без взаимоблокировок между пачками), и читатели видят либо
+  // все изменения пачки, либо ни одного. В WAL пачка ложится одним куском
+  void write(const WriteBatch &batch);
+};
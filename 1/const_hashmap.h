@@ -0,0 +1,89 @@
+#pragma once
+
+#include "hashers.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+using TConstEntry = std::pair<TKey, std::string_view>;
+
+// Таблица, целиком построенная при компиляции: открытая адресация с
+// линейным пробированием и заполнением не больше половины. Значения
+// скопированы в общий массив байт, поэтому в объекте нет указателей:
+// объявленный как constexpr, он попадает в .rodata без релокаций и
+// не требует никакой работы при старте программы
+template <size_t N, size_t Bytes> class ConstHashMap {
+public:
+  static constexpr int CAPACITY = roundCapacity(int(N) * 2);
+
+private:
+  // index - номер значения + 1, 0 - пустой слот
+  struct Slot {
+    TKey key;
+    uint32_t index;
+  };
+
+  std::array<Slot, CAPACITY> slots{};
+  std::array<uint32_t, N + 1> offsets{};
+  std::array<char, Bytes> pool{};
+
+  static constexpr int home(TKey key) {
+    return reduceFibonacci(static_cast<uint32_t>(key), CAPACITY);
+  }
+
+  constexpr int find(TKey key) const {
+    int slot = home(key);
+    while (slots[slot].index && slots[slot].key != key)
+      slot = (slot + 1) & (CAPACITY - 1);
+    return slot;
+  }
+
+public:
+  // consteval, чтобы повтор ключа был ошибкой компиляции
+  consteval explicit ConstHashMap(const std::array<TConstEntry, N> &entries) {
+    uint32_t offset = 0;
+    for (size_t i = 0; i < N; i++) {
+      int slot = find(entries[i].first);
+      if (slots[slot].index)
+        throw "ConstHashMap: duplicate key";
+      slots[slot] = Slot{entries[i].first, static_cast<uint32_t>(i + 1)};
+      offsets[i] = offset;
+      for (char c : entries[i].second)
+        pool[offset++] = c;
+    }
+    offsets[N] = offset;
+  }
+
+  constexpr bool has(TKey key) const { return slots[find(key)].index != 0; }
+
+  constexpr std::optional<std::string_view> get(TKey key) const {
+    uint32_t index = slots[find(key)].index;
+    if (!index)
+      return std::nullopt;
+    return std::string_view(pool.data() + offsets[index - 1],
+                            offsets[index] - offsets[index - 1]);
+  }
+
+  constexpr int getSize() const { return static_cast<int>(N); }
+};
+
+template <size_t N>
+constexpr size_t constValueBytes(const std::array<TConstEntry, N> &entries) {
+  size_t bytes = 0;
+  for (auto &entry : entries)
+    bytes += entry.second.size();
+  return bytes;
+}
+
+// Размеры таблицы должны быть известны как параметры шаблона, поэтому
+// записи передаются лямбдой без захвата, возвращающей std::array:
+//   constexpr auto TABLE = makeConstHashMap([] {
+//     return std::array{TConstEntry{1, "one"}, TConstEntry{2, "two"}};
+//   });
+template <typename Source> consteval auto makeConstHashMap(Source) {
+  constexpr auto entries = Source{}();
+  return ConstHashMap<entries.size(), constValueBytes(entries)>(entries);
+}
@@ -0,0 +1,139 @@
+#include "durable_hashmap.h"
+#include "thread_pool.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Подряд идущие SET при восстановлении копятся и вставляются через
+// parallelBuild пачками по REPLAY_BATCH (так снапшот не держится в памяти
+// целиком); REMOVE или конец лога сбрасывает неполную пачку через set
+constexpr size_t REPLAY_BATCH = 1 << 16;
+// Размер пачки при записи снапшота
+constexpr int SNAPSHOT_BATCH = 1 << 16;
+
+static std::string walPath(const std::string &path) { return path + ".wal"; }
+
+static std::string snapshotPath(const std::string &path) {
+  return path + ".snapshot";
+}
+
+static void syncDirectory(const std::string &path) {
+  auto slash = path.rfind('/');
+  std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+  int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "open " + directory);
+  int result = fsync(fd);
+  int error = errno;
+  close(fd);
+  if (result < 0)
+    throw std::system_error(error, std::generic_category(), "fsync " + directory);
+}
+
+DurableHashMap::DurableHashMap(const std::string &path, int capacity,
+                               int groupCommit)
+    : path(path), map(capacity), wal(walPath(path)),
+      groupCommit(std::max(groupCommit, 1)), unsynced(0) {
+  recover();
+}
+
+void DurableHashMap::recover() {
+  std::vector<std::pair<TKey, TVal>> sets;
+  // Один пул на всё восстановление, а не по пулу на каждую пачку
+  ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+  auto flush = [&]() {
+    if (sets.size() == REPLAY_BATCH) {
+      map.parallelBuild(std::move(sets), pool);
+    } else {
+      for (auto &[key, value] : sets)
+        map.set(key, std::move(value));
+    }
+    sets.clear();
+  };
+  auto apply = [&](WalOp op, TKey key, const char *value, uint32_t length) {
+    if (op == WalOp::Set) {
+      sets.emplace_back(key, TVal(value, length));
+      if (sets.size() == REPLAY_BATCH)
+        flush();
+      return;
+    }
+    flush();
+    map.remove(key);
+  };
+
+  if (access(snapshotPath(path).c_str(), F_OK) == 0) {
+    WriteAheadLog snapshot(snapshotPath(path));
+    snapshot.replay(apply);
+  }
+  wal.replay(apply);
+  flush();
+}
+
+void DurableHashMap::logged(WalOp op, TKey key, const TVal &value) {
+  uint64_t lsn = wal.append(op, key, value);
+  if (++unsynced >= groupCommit) {
+    wal.sync(lsn);
+    unsynced = 0;
+  }
+}
+
+std::optional<TVal> DurableHashMap::remove(TKey key) {
+  auto value = map.remove(key);
+  if (value)
+    logged(WalOp::Remove, key, TVal());
+  return value;
+}
+
+bool DurableHashMap::has(TKey key) { return map.has(key); }
+
+void DurableHashMap::set(TKey key, TVal val) {
+  logged(WalOp::Set, key, val);
+  map.set(key, std::move(val));
+}
+
+int DurableHashMap::getSize() { return map.getSize(); }
+
+std::optional<TVal> DurableHashMap::get(TKey key) { return map.get(key); }
+
+void DurableHashMap::sync() {
+  wal.sync();
+  unsynced = 0;
+}
+
+// Снапшот пишется во временный файл в формате WAL из одних SET и атомарно
+// подменяет старый через rename. Если процесс упадёт до обрезки лога,
+// лог проиграется поверх нового снапшота - set/remove идемпотентны,
+// поэтому результат тот же
+void DurableHashMap::checkpoint() {
+  std::string temporary = snapshotPath(path) + ".tmp";
+  ::unlink(temporary.c_str());
+  {
+    WriteAheadLog snapshot(temporary);
+    int batched = 0;
+    for (auto [key, value] : map) {
+      snapshot.append(WalOp::Set, key, value);
+      if (++batched == SNAPSHOT_BATCH) {
+        snapshot.sync();
+        batched = 0;
+      }
+    }
+    snapshot.sync();
+  }
+  if (rename(temporary.c_str(), snapshotPath(path).c_str()) < 0)
+    throw std::system_error(errno, std::generic_category(),
+                            "rename " + temporary);
+  syncDirectory(path);
+  wal.truncate();
+  unsynced = 0;
+}
+
+uint64_t DurableHashMap::getLogBytes() { return wal.getLogBytes(); }
+
+void DurableHashMap::unlink(const std::string &path) {
+  ::unlink(walPath(path).c_str());
+  ::unlink(snapshotPath(path).c_str());
+  ::unlink((snapshotPath(path) + ".tmp").c_str());
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "hashmap.h"
+#include "wal.h"
+#include <string>
+
+// HashMap, переживающий падение процесса: каждое изменение пишется в WAL
+// (path + ".wal"), который сбрасывается на диск раз в groupCommit операций.
+// checkpoint() сохраняет всю таблицу в path + ".snapshot" и обрезает лог;
+// при открытии таблица восстанавливается из снапшота и остатка лога.
+// После падения теряется не больше groupCommit - 1 последних операций
+class DurableHashMap {
+private:
+  std::string path;
+  HashMap map;
+  WriteAheadLog wal;
+  int groupCommit;
+  int unsynced;
+
+  void recover();
+  void logged(WalOp op, TKey key, const TVal &value);
+
+public:
+  DurableHashMap(const std::string &path, int capacity, int groupCommit);
+
+  DurableHashMap(const DurableHashMap &) = delete;
+  DurableHashMap &operator=(const DurableHashMap &) = delete;
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, TVal val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+
+  // Дожидается, пока все операции не окажутся на диске
+  void sync();
+
+  void checkpoint();
+
+  uint64_t getLogBytes();
+
+  static void unlink(const std::string &path);
+};
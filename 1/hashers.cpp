@@ -0,0 +1,133 @@
+#include "hashers.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define USE_SSE42_CRC 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define USE_ARM_CRC 1
+#endif
+
+uint64_t hashMultiplicative(TKey key) {
+  return static_cast<uint32_t>(key) * FIBONACCI_MULTIPLIER;
+}
+
+uint64_t hashMurmur3(TKey key) {
+  uint64_t h = static_cast<uint32_t>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+static uint32_t crc32cSoftware(uint32_t value) {
+  uint32_t crc = 0xFFFFFFFFu ^ value;
+  for (int i = 0; i < 32; i++)
+    crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+  return crc;
+}
+
+#if defined(USE_SSE42_CRC)
+
+__attribute__((target("sse4.2"))) static uint32_t crc32cHardware(uint32_t value) {
+  return _mm_crc32_u32(0xFFFFFFFFu, value);
+}
+
+static const bool hasHardwareCrc = __builtin_cpu_supports("sse4.2");
+
+uint64_t hashCrc32c(TKey key) {
+  uint32_t value = static_cast<uint32_t>(key);
+  uint32_t crc = hasHardwareCrc ? crc32cHardware(value) : crc32cSoftware(value);
+  return (static_cast<uint64_t>(crc) << 32) | crc;
+}
+
+#elif defined(USE_ARM_CRC)
+
+uint64_t hashCrc32c(TKey key) {
+  uint32_t crc = __crc32cw(0xFFFFFFFFu, static_cast<uint32_t>(key));
+  return (static_cast<uint64_t>(crc) << 32) | crc;
+}
+
+#else
+
+uint64_t hashCrc32c(TKey key) {
+  uint32_t crc = crc32cSoftware(static_cast<uint32_t>(key));
+  return (static_cast<uint64_t>(crc) << 32) | crc;
+}
+
+#endif
+
+static constexpr uint64_t WY_SECRET[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+    0x4d5a2da51de1aa47ull};
+
+static inline void wyMum(uint64_t &a, uint64_t &b) {
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  a = static_cast<uint64_t>(r);
+  b = static_cast<uint64_t>(r >> 64);
+}
+
+static inline uint64_t wyMix(uint64_t a, uint64_t b) {
+  wyMum(a, b);
+  return a ^ b;
+}
+
+// wyhash (final v4) для 4-байтного ключа
+uint64_t hashWy(TKey key, uint64_t seed) {
+  uint64_t k = static_cast<uint32_t>(key);
+  seed ^= wyMix(seed ^ WY_SECRET[0], WY_SECRET[1]);
+  uint64_t a = ((k << 32) | k) ^ WY_SECRET[1];
+  uint64_t b = ((k << 32) | k) ^ seed;
+  wyMum(a, b);
+  return wyMix(a ^ WY_SECRET[0] ^ sizeof(TKey), b ^ WY_SECRET[1]);
+}
+
+template <uint64_t (*Hash)(TKey)>
+static THashFunction withReduction(Reduction reduction) {
+  if (reduction == Reduction::Mask)
+    return [](TKey key, int capacity) { return reduceMask(Hash(key), capacity); };
+  return [](TKey key, int capacity) {
+    return reduceFibonacci(Hash(key), capacity);
+  };
+}
+
+THashFunction makeHashFunction(HashKind kind, Reduction reduction,
+                               uint64_t seed) {
+  switch (kind) {
+  case HashKind::Multiplicative:
+    return withReduction<hashMultiplicative>(reduction);
+  case HashKind::Murmur3:
+    return withReduction<hashMurmur3>(reduction);
+  case HashKind::Crc32c:
+    return withReduction<hashCrc32c>(reduction);
+  case HashKind::WyHash:
+    if (reduction == Reduction::Mask)
+      return [seed](TKey key, int capacity) {
+        return reduceMask(hashWy(key, seed), capacity);
+      };
+    return [seed](TKey key, int capacity) {
+      return reduceFibonacci(hashWy(key, seed), capacity);
+    };
+  }
+  return withReduction<hashMultiplicative>(reduction);
+}
+
+const char *hashKindName(HashKind kind) {
+  switch (kind) {
+  case HashKind::Multiplicative:
+    return "multiplicative";
+  case HashKind::Murmur3:
+    return "murmur3";
+  case HashKind::Crc32c:
+    return "crc32c";
+  case HashKind::WyHash:
+    return "wyhash";
+  }
+  return "unknown";
+}
+
+const char *reductionName(Reduction reduction) {
+  return reduction == Reduction::Mask ? "mask" : "fibonacci";
+}
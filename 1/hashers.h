@@ -0,0 +1,42 @@
+#pragma once
+
+#include "hashmap.h"
+#include <bit>
+#include <cstdint>
+
+enum class HashKind { Multiplicative, Murmur3, Crc32c, WyHash };
+
+enum class Reduction { Mask, Fibonacci };
+
+constexpr uint64_t FIBONACCI_MULTIPLIER = 11400714819323198485ull;
+
+uint64_t hashMultiplicative(TKey key);
+
+uint64_t hashMurmur3(TKey key);
+
+uint64_t hashCrc32c(TKey key);
+
+uint64_t hashWy(TKey key, uint64_t seed);
+
+constexpr int roundCapacity(int capacity) {
+  return static_cast<int>(
+      std::bit_ceil(static_cast<unsigned>(capacity > 1 ? capacity : 1)));
+}
+
+// capacity всегда степень двойки (см. конструктор HashMap)
+constexpr int reduceMask(uint64_t hash, int capacity) {
+  return static_cast<int>(hash & static_cast<uint64_t>(capacity - 1));
+}
+
+// Берём старшие биты произведения; двойной сдвиг убирает UB при capacity == 1
+constexpr int reduceFibonacci(uint64_t hash, int capacity) {
+  int bits = std::countr_zero(static_cast<unsigned>(capacity));
+  return static_cast<int>(((hash * FIBONACCI_MULTIPLIER) >> (63 - bits)) >> 1);
+}
+
+THashFunction makeHashFunction(HashKind kind, Reduction reduction,
+                               uint64_t seed = 0);
+
+const char *hashKindName(HashKind kind);
+
+const char *reductionName(Reduction reduction);
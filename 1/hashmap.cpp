@@ -1,38 +1,131 @@
 #include "hashmap.h"
+#include "access_sampler.h"
+#include "hashers.h"
+#include <bit>
 #include <cassert>
 #include <functional>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
 
 THashFunction getDefaultHashFunction() {
   return [](TKey key, int capacity) -> int {
-    return (key * 2654435761) % (1 << 30) % capacity;
+    return reduceFibonacci(static_cast<uint32_t>(key), capacity);
   };
 }
 
 HashMap::HashMap(int capacity)
-    : buckets(new LinkedList *[capacity]), bucketsSize(capacity), size(0),
-      hashFunction(getDefaultHashFunction()) {
-  std::fill(buckets, buckets + capacity, nullptr);
-}
+    : HashMap(capacity, getDefaultHashFunction()) {}
 
 HashMap::HashMap(int capacity, THashFunction hf)
-    : buckets(new LinkedList *[capacity]), bucketsSize(capacity), size(0),
-      hashFunction(hf) {
-  std::fill(buckets, buckets + capacity, nullptr);
+    : HashMap(capacity, hf, std::pmr::get_default_resource()) {}
+
+HashMap::HashMap(int capacity, std::pmr::memory_resource *resource)
+    : HashMap(capacity, getDefaultHashFunction(), resource) {}
+
+HashMap::HashMap(int capacity, THashFunction hf,
+                 std::pmr::memory_resource *resource)
+    : buckets(nullptr), bucketsSize(roundCapacity(capacity)), size(0),
+      hashFunction(hf), resource(resource) {
+  std::fill(smallKeys, smallKeys + SMALL_MAP_SIZE, 0);
 }
 
 HashMap::~HashMap() {
+  if (!buckets)
+    return;
   for (int i = 0; i < bucketsSize; i++) {
     auto node = buckets[i];
     while (node) {
       auto next = node->next;
-      delete node;
+      destroyNode(node);
       node = next;
     }
   }
-  delete[] buckets;
+  deallocateBuckets(buckets, bucketsSize);
+}
+
+LinkedList *HashMap::createNode(LinkedList *next, TKey key, TVal value) {
+  std::pmr::polymorphic_allocator<LinkedList> allocator(resource);
+  return allocator.new_object<LinkedList>(
+      LinkedList{next, key, std::move(value)});
+}
+
+void HashMap::destroyNode(LinkedList *node) {
+  std::pmr::polymorphic_allocator<LinkedList> allocator(resource);
+  allocator.delete_object(node);
+}
+
+LinkedList **HashMap::allocateBuckets(int count) {
+  auto array = static_cast<LinkedList **>(
+      resource->allocate(count * sizeof(LinkedList *), alignof(LinkedList *)));
+  std::fill(array, array + count, nullptr);
+  return array;
+}
+
+void HashMap::deallocateBuckets(LinkedList **array, int count) {
+  resource->deallocate(array, count * sizeof(LinkedList *),
+                       alignof(LinkedList *));
+}
+
+int HashMap::findSmall(TKey key) {
+#if defined(USE_SSE2)
+  __m128i needle = _mm_set1_epi32(key);
+  __m128i low = _mm_load_si128(reinterpret_cast<const __m128i *>(smallKeys));
+  __m128i high = _mm_load_si128(reinterpret_cast<const __m128i *>(smallKeys + 4));
+  unsigned mask =
+      _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(low, needle))) |
+      (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(high, needle))) << 4);
+#elif defined(USE_NEON)
+  int32x4_t needle = vdupq_n_s32(key);
+  uint32x4_t low = vceqq_s32(vld1q_s32(smallKeys), needle);
+  uint32x4_t high = vceqq_s32(vld1q_s32(smallKeys + 4), needle);
+  uint8x8_t bytes = vmovn_u16(vcombine_u16(vmovn_u32(low), vmovn_u32(high)));
+  uint64_t lanes = vget_lane_u64(vreinterpret_u64_u8(bytes), 0);
+  unsigned mask = 0;
+  for (int i = 0; i < SMALL_MAP_SIZE; i++)
+    mask |= ((lanes >> (i * 8)) & 1) << i;
+#else
+  unsigned mask = 0;
+  for (int i = 0; i < SMALL_MAP_SIZE; i++)
+    mask |= unsigned(smallKeys[i] == key) << i;
+#endif
+  mask &= (1u << size) - 1;
+  return mask ? std::countr_zero(mask) : -1;
+}
+
+void HashMap::upgrade() {
+  buckets = allocateBuckets(bucketsSize);
+  for (int i = 0; i < size; i++) {
+    int hash = hashFunction(smallKeys[i], bucketsSize);
+    buckets[hash] =
+        createNode(buckets[hash], smallKeys[i], std::move(smallValues[i]));
+    smallValues[i] = TVal();
+  }
+}
+
+void HashMap::reserveBuckets() {
+  if (!buckets)
+    upgrade();
 }
 
 std::optional<TVal> HashMap::remove(TKey key) {
+  if (!buckets) {
+    int index = findSmall(key);
+    if (index < 0)
+      return std::nullopt;
+    TVal value = std::move(smallValues[index]);
+    size--;
+    smallKeys[index] = smallKeys[size];
+    smallValues[index] = std::move(smallValues[size]);
+    smallValues[size] = TVal();
+    return value;
+  }
   int hash = hashFunction(key, bucketsSize);
   auto curr = buckets[hash];
   if (!curr)
@@ -49,12 +142,14 @@ std::optional<TVal> HashMap::remove(TKey key) {
   else
     buckets[hash] = curr->next;
   TVal value = curr->value;
-  delete curr;
+  destroyNode(curr);
   size--;
   return value;
 }
 
 bool HashMap::has(TKey key) {
+  if (!buckets)
+    return findSmall(key) >= 0;
   auto bucket = buckets[hashFunction(key, bucketsSize)];
   if (!bucket)
     return false;
@@ -64,26 +159,50 @@ bool HashMap::has(TKey key) {
 }
 
 void HashMap::set(TKey key, TVal val) {
+  if (!buckets) {
+    int index = findSmall(key);
+    if (index >= 0) {
+      smallValues[index] = std::move(val);
+      return;
+    }
+    if (size < SMALL_MAP_SIZE) {
+      smallKeys[size] = key;
+      smallValues[size] = std::move(val);
+      size++;
+      return;
+    }
+    upgrade();
+  }
   int hash = hashFunction(key, bucketsSize);
   auto bucket = buckets[hash];
   if (!bucket) {
-    buckets[hash] = new LinkedList{nullptr, key, val};
+    buckets[hash] = createNode(nullptr, key, std::move(val));
     size++;
     return;
   }
   while (bucket->next && bucket->key != key)
     bucket = bucket->next;
   if (bucket->key == key)
-    bucket->value = val;
+    bucket->value = std::move(val);
   else {
-    bucket->next = new LinkedList{nullptr, key, val};
+    bucket->next = createNode(nullptr, key, std::move(val));
     size++;
   }
 }
 
 int HashMap::getSize() { return size; }
 
+int HashMap::getCapacity() { return bucketsSize; }
+
 std::optional<TVal> HashMap::get(TKey key) {
+  if (sampler)
+    sampler->sample(key);
+  if (!buckets) {
+    int index = findSmall(key);
+    if (index < 0)
+      return std::nullopt;
+    return smallValues[index];
+  }
   auto bucket = buckets[hashFunction(key, bucketsSize)];
   if (!bucket)
     return std::nullopt;
@@ -93,3 +212,176 @@ std::optional<TVal> HashMap::get(TKey key) {
     return bucket->value;
   return std::nullopt;
 }
+
+void AccessSamplerDeleter::operator()(AccessSampler *sampler) const {
+  std::pmr::polymorphic_allocator<AccessSampler> allocator(resource);
+  allocator.delete_object(sampler);
+}
+
+void HashMap::enableSampling(int sampleRate) {
+  std::pmr::polymorphic_allocator<AccessSampler> allocator(resource);
+  sampler = std::unique_ptr<AccessSampler, AccessSamplerDeleter>(
+      allocator.new_object<AccessSampler>(sampleRate, resource),
+      AccessSamplerDeleter{resource});
+}
+
+void HashMap::disableSampling() { sampler.reset(); }
+
+std::vector<std::pair<TKey, uint64_t>> HashMap::topKeys(int k) {
+  if (!sampler)
+    return {};
+  return sampler->topKeys(k);
+}
+
+void HashMap::rehash(int capacity) {
+  int newSize = roundCapacity(capacity);
+  if (!buckets) {
+    bucketsSize = newSize;
+    return;
+  }
+  auto fresh = allocateBuckets(newSize);
+  for (int i = 0; i < bucketsSize; i++) {
+    auto node = buckets[i];
+    while (node) {
+      auto next = node->next;
+      int hash = hashFunction(node->key, newSize);
+      node->next = fresh[hash];
+      fresh[hash] = node;
+      node = next;
+    }
+  }
+  deallocateBuckets(buckets, bucketsSize);
+  buckets = fresh;
+  bucketsSize = newSize;
+}
+
+// Узлы цепочек разбросаны по куче, поэтому заранее подтягиваем голову
+// бакета на SCAN_PREFETCH_DISTANCE вперёд; сам массив бакетов читается
+// последовательно и хорошо предвыбирается аппаратно
+constexpr int SCAN_PREFETCH_DISTANCE = 8;
+
+static inline void prefetchBucket(LinkedList **buckets, int index,
+                                  int bucketsSize) {
+#if defined(__GNUC__)
+  if (index < bucketsSize && buckets[index])
+    __builtin_prefetch(buckets[index]);
+#endif
+}
+
+std::vector<std::optional<TVal>>
+HashMap::getMany(const std::vector<TKey> &keys) {
+  std::vector<std::optional<TVal>> result(keys.size());
+  if (!buckets) {
+    for (size_t i = 0; i < keys.size(); i++)
+      result[i] = get(keys[i]);
+    return result;
+  }
+  std::pmr::vector<int> hashes(keys.size(), resource);
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (sampler)
+      sampler->sample(keys[i]);
+    hashes[i] = hashFunction(keys[i], bucketsSize);
+#if defined(__GNUC__)
+    __builtin_prefetch(&buckets[hashes[i]]);
+#endif
+  }
+  for (size_t i = 0; i < keys.size(); i++)
+    prefetchBucket(buckets, hashes[i], bucketsSize);
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto node = buckets[hashes[i]];
+    while (node && node->key != keys[i])
+      node = node->next;
+    if (node)
+      result[i] = node->value;
+  }
+  return result;
+}
+
+HashMap::iterator::iterator(HashMap *map, int bucket, LinkedList *node)
+    : map(map), bucket(bucket), node(node) {
+  settle();
+}
+
+void HashMap::iterator::settle() {
+  if (!map->buckets)
+    return;
+  while (!node && bucket + 1 < map->bucketsSize) {
+    bucket++;
+    prefetchBucket(map->buckets, bucket + SCAN_PREFETCH_DISTANCE,
+                   map->bucketsSize);
+    node = map->buckets[bucket];
+  }
+  if (!node)
+    bucket = map->bucketsSize;
+}
+
+HashMap::iterator::reference HashMap::iterator::operator*() const {
+  if (!map->buckets)
+    return {map->smallKeys[bucket], map->smallValues[bucket]};
+  return {node->key, node->value};
+}
+
+HashMap::iterator &HashMap::iterator::operator++() {
+  if (!map->buckets) {
+    bucket++;
+    return *this;
+  }
+  node = node->next;
+  settle();
+  return *this;
+}
+
+HashMap::iterator HashMap::iterator::operator++(int) {
+  iterator copy = *this;
+  ++*this;
+  return copy;
+}
+
+HashMap::iterator HashMap::begin() {
+  if (!buckets)
+    return iterator(this, 0, nullptr);
+  return iterator(this, -1, nullptr);
+}
+
+HashMap::iterator HashMap::end() {
+  if (!buckets)
+    return iterator(this, size, nullptr);
+  return iterator(this, bucketsSize, nullptr);
+}
+
+// Курсор - 32-битная доля пространства хэшей: бакет i таблицы из 2^bits
+// бакетов покрывает [i << (32 - bits), (i + 1) << (32 - bits)). При
+// увеличении таблицы граница бакета остаётся границей, при уменьшении
+// текущий бакет просто просматривается повторно
+constexpr int SCAN_CURSOR_BITS = 32;
+constexpr uint64_t SCAN_CURSOR_END = 1ull << SCAN_CURSOR_BITS;
+// Как в Redis: ограничиваем число пустых бакетов за вызов
+constexpr int SCAN_EMPTY_VISITS = 10;
+
+uint64_t HashMap::scan(uint64_t cursor, int batch,
+                       const std::function<void(TKey, const TVal &)> &fn) {
+  if (batch <= 0)
+    throw std::invalid_argument("scan batch must be positive");
+  if (!buckets) {
+    for (int i = 0; i < size; i++)
+      fn(smallKeys[i], smallValues[i]);
+    return 0;
+  }
+  int shift = SCAN_CURSOR_BITS - std::countr_zero(unsigned(bucketsSize));
+  int bucket = static_cast<int>(cursor >> shift);
+  int emitted = 0;
+  int64_t emptyBudget = int64_t(batch) * SCAN_EMPTY_VISITS;
+  while (bucket < bucketsSize && emitted < batch && emptyBudget > 0) {
+    prefetchBucket(buckets, bucket + SCAN_PREFETCH_DISTANCE, bucketsSize);
+    auto node = buckets[bucket];
+    if (!node)
+      emptyBudget--;
+    for (; node; node = node->next) {
+      fn(node->key, node->value);
+      emitted++;
+    }
+    bucket++;
+  }
+  uint64_t next = static_cast<uint64_t>(bucket) << shift;
+  return next >= SCAN_CURSOR_END ? 0 : next;
+}
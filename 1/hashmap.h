@@ -1,35 +1,114 @@
+#pragma once
+
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 typedef std::string TVal;
 typedef int TKey;
 typedef std::function<int(TKey, int)> THashFunction;
 
+THashFunction getDefaultHashFunction();
+
+class AccessSampler;
+class ThreadPool;
+
+// Пока в таблице не больше SMALL_MAP_SIZE пар, они лежат прямо в объекте,
+// а массив бакетов не выделяется
+constexpr int SMALL_MAP_SIZE = 8;
+
 struct LinkedList {
   LinkedList *next;
   TKey key;
   TVal value;
 };
 
+// Освобождает AccessSampler, созданный из memory_resource таблицы
+struct AccessSamplerDeleter {
+  std::pmr::memory_resource *resource = nullptr;
+  void operator()(AccessSampler *sampler) const;
+};
+
 class HashMap {
 private:
   LinkedList **buckets;
   int bucketsSize;
   int size;
   THashFunction hashFunction;
+  // Встроенные пары остаются в объекте и после upgrade(): union с состоянием
+  // бакетов (указатель и размер) sizeof(HashMap) не уменьшит, а вынос в кучу
+  // вернёт аллокацию, от которой маленькие таблицы и избавлялись
+  alignas(16) TKey smallKeys[SMALL_MAP_SIZE];
+  TVal smallValues[SMALL_MAP_SIZE];
+  std::unique_ptr<AccessSampler, AccessSamplerDeleter> sampler;
+  // Узлы, массив бакетов, AccessSampler и временные массивы getMany и
+  // parallel*-операций выделяются из resource
+  std::pmr::memory_resource *resource;
+
+  int findSmall(TKey key);
+  void upgrade();
+  LinkedList *createNode(LinkedList *next, TKey key, TVal value);
+  void destroyNode(LinkedList *node);
+  LinkedList **allocateBuckets(int count);
+  void deallocateBuckets(LinkedList **array, int count);
 
 public:
+  // Обход в порядке бакетов в памяти; любое изменение таблицы, кроме записи
+  // в value, инвалидирует итераторы
+  class iterator {
+  private:
+    HashMap *map;
+    int bucket;
+    LinkedList *node;
+
+    void settle();
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::pair<const TKey, TVal>;
+    using reference = std::pair<const TKey &, TVal &>;
+
+    iterator() : map(nullptr), bucket(0), node(nullptr) {}
+    iterator(HashMap *map, int bucket, LinkedList *node);
+
+    reference operator*() const;
+    iterator &operator++();
+    iterator operator++(int);
+    bool operator==(const iterator &other) const = default;
+  };
+
   HashMap(int capacity);
 
   HashMap(int capacity, THashFunction hf);
 
+  HashMap(int capacity, std::pmr::memory_resource *resource);
+
+  // Все внутренние выделения таблицы идут через resource, кроме трёх:
+  // буферы самих TVal (std::string со стандартным аллокатором), результаты
+  // getMany и topKeys (принадлежат вызывающему) и потоки, задачи и future
+  // ThreadPool в parallel*-операциях - пул блокирует resource своим
+  // замком, несогласованным с замком таблицы
+  HashMap(int capacity, THashFunction hf, std::pmr::memory_resource *resource);
+
   ~HashMap();
 
+  HashMap(const HashMap &) = delete;
+  HashMap &operator=(const HashMap &) = delete;
+
+  // Сразу переходит к хэшированной раскладке, минуя inline-режим
+  void reserveBuckets();
+
   std::optional<TVal> remove(TKey key);
 
   bool has(TKey key);
@@ -38,5 +117,63 @@ public:
 
   int getSize();
 
+  int getCapacity();
+
   std::optional<TVal> get(TKey key);
+
+  // Пакетный get: сначала считает хэши всех ключей и подтягивает бакеты,
+  // затем головы цепочек, и только потом проходит цепочки, так что промахи
+  // кэша по разным ключам перекрываются
+  std::vector<std::optional<TVal>> getMany(const std::vector<TKey> &keys);
+
+  iterator begin();
+
+  iterator end();
+
+  // Возобновляемый обход как SCAN в Redis: начинается с cursor == 0, за вызов
+  // отдаёт в fn целые бакеты, пока не наберёт batch пар, и возвращает курсор
+  // для следующего вызова (0 - обход закончен). Курсор - доля пространства
+  // хэшей, поэтому переживает rehash между вызовами: каждая пара, лежавшая
+  // в таблице весь обход, будет выдана хотя бы раз (возможны повторы).
+  // Гарантия требует, чтобы бакет определялся старшими битами хэша, как у
+  // хэш-функции по умолчанию (Reduction::Fibonacci). batch <= 0 -
+  // std::invalid_argument
+  uint64_t scan(uint64_t cursor, int batch,
+                const std::function<void(TKey, const TVal &)> &fn);
+
+  // Учёт горячих ключей в get: каждое ~sampleRate-е обращение попадает в
+  // AccessSampler. Пока учёт выключен, get платит одну проверку указателя
+  void enableSampling(int sampleRate);
+
+  void disableSampling();
+
+  // До k самых частых ключей get с оценкой числа обращений; пусто, если
+  // учёт выключен
+  std::vector<std::pair<TKey, uint64_t>> topKeys(int k);
+
+  // Перестраивает таблицу под новое число бакетов, узлы не копируются
+  void rehash(int capacity);
+
+  // Массовые операции на ThreadPool (num_threads == 0 - по числу ядер).
+  // Массив бакетов делится на непересекающиеся диапазоны по хэшу, каждый
+  // поток владеет своим диапазоном, поэтому блокировки не нужны (кроме
+  // обращений к нестандартному memory_resource, который может быть не
+  // потокобезопасным).
+  // При повторе ключа в items побеждает последнее вхождение, как у set
+  void parallelBuild(std::vector<std::pair<TKey, TVal>> items,
+                     size_t numThreads);
+
+  // То же на пуле вызывающего: тот, кто строит таблицу пачками (например,
+  // восстановление DurableHashMap), не создаёт потоки на каждую пачку
+  void parallelBuild(std::vector<std::pair<TKey, TVal>> items,
+                     ThreadPool &pool);
+
+  void parallelForEach(const std::function<void(TKey, TVal &)> &fn,
+                       size_t numThreads);
+
+  // Возвращает число удалённых пар
+  int parallelEraseIf(const std::function<bool(TKey, const TVal &)> &pred,
+                      size_t numThreads);
+
+  void parallelRehash(int capacity, size_t numThreads);
 };
@@ -0,0 +1,250 @@
+#include "hashers.h"
+#include "hashmap.h"
+#include "thread_pool.h"
+#include <future>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+static size_t resolveThreads(size_t numThreads, int bucketsSize) {
+  if (numThreads == 0)
+    numThreads = std::thread::hardware_concurrency();
+  return std::clamp<size_t>(numThreads, 1, bucketsSize);
+}
+
+// Раздел p владеет бакетами [partitionBegin(p), partitionBegin(p + 1));
+// partitionOf согласован с этими границами
+static int partitionBegin(size_t partition, size_t partitions, int bucketsSize) {
+  return static_cast<int>(
+      (static_cast<int64_t>(partition) * bucketsSize + partitions - 1) /
+      partitions);
+}
+
+static size_t partitionOf(int hash, size_t partitions, int bucketsSize) {
+  return static_cast<size_t>(static_cast<int64_t>(hash) * partitions /
+                             bucketsSize);
+}
+
+// new_delete_resource потокобезопасен, а про пользовательский resource
+// (monotonic, unsynchronized_pool) этого не известно, поэтому выделения
+// из него в рабочих потоках сериализуются
+class ResourceGuard {
+private:
+  SpinLock *lock;
+
+public:
+  ResourceGuard(std::pmr::memory_resource *resource, SpinLock &spin)
+      : lock(resource == std::pmr::new_delete_resource() ? nullptr : &spin) {
+    if (lock)
+      lock->lock();
+  }
+  ~ResourceGuard() {
+    if (lock)
+      lock->unlock();
+  }
+};
+
+// Добавляет value в вектор на resource таблицы; замок берётся, только когда
+// вектору нужно перевыделить память
+template <typename T>
+static void appendGuarded(std::pmr::vector<T> &target, T value,
+                          std::pmr::memory_resource *resource, SpinLock &spin) {
+  if (target.size() < target.capacity()) {
+    target.push_back(std::move(value));
+    return;
+  }
+  ResourceGuard guard(resource, spin);
+  target.push_back(std::move(value));
+}
+
+// Запускает fn(0..partitions-1) в пуле и ждёт все задачи, даже если
+// какая-то из них бросила исключение
+template <typename Fn>
+static void runPartitions(ThreadPool &pool, size_t partitions, Fn fn) {
+  std::vector<std::future<void>> futures;
+  futures.reserve(partitions);
+  for (size_t p = 0; p < partitions; p++)
+    futures.push_back(pool.submit([&fn, p]() { fn(p); }));
+  for (auto &future : futures)
+    future.wait();
+  for (auto &future : futures)
+    future.get();
+}
+
+void HashMap::parallelBuild(std::vector<std::pair<TKey, TVal>> items,
+                            size_t numThreads) {
+  if (items.empty())
+    return;
+  reserveBuckets();
+  ThreadPool pool(resolveThreads(numThreads, bucketsSize));
+  parallelBuild(std::move(items), pool);
+}
+
+void HashMap::parallelBuild(std::vector<std::pair<TKey, TVal>> items,
+                            ThreadPool &pool) {
+  if (items.empty())
+    return;
+  reserveBuckets();
+  size_t partitions = std::clamp<size_t>(pool.size(), 1, bucketsSize);
+
+  // Фаза 1: каждый поток хэширует свой кусок items и раскладывает индексы
+  // по разделам. Фаза 2: каждый поток вставляет свой раздел, обходя куски
+  // по порядку, чтобы повторы ключей применялись как в последовательном set
+  std::pmr::vector<int> hashes(items.size(), resource);
+  std::pmr::vector<std::pmr::vector<std::pmr::vector<uint32_t>>> scatter(
+      resource);
+  scatter.resize(partitions);
+  for (auto &row : scatter)
+    row.resize(partitions);
+  std::pmr::vector<int> inserted(partitions, 0, resource);
+  SpinLock resourceLock;
+
+  runPartitions(pool, partitions, [&](size_t worker) {
+    size_t begin = items.size() * worker / partitions;
+    size_t end = items.size() * (worker + 1) / partitions;
+    for (size_t i = begin; i < end; i++) {
+      hashes[i] = hashFunction(items[i].first, bucketsSize);
+      appendGuarded(
+          scatter[worker][partitionOf(hashes[i], partitions, bucketsSize)],
+          uint32_t(i), resource, resourceLock);
+    }
+  });
+
+  runPartitions(pool, partitions, [&](size_t partition) {
+    int added = 0;
+    for (size_t worker = 0; worker < partitions; worker++) {
+      for (uint32_t i : scatter[worker][partition]) {
+        auto &[key, value] = items[i];
+        auto node = buckets[hashes[i]];
+        while (node && node->key != key)
+          node = node->next;
+        if (node) {
+          node->value = std::move(value);
+        } else {
+          ResourceGuard guard(resource, resourceLock);
+          buckets[hashes[i]] =
+              createNode(buckets[hashes[i]], key, std::move(value));
+          added++;
+        }
+      }
+    }
+    inserted[partition] = added;
+  });
+
+  for (int added : inserted)
+    size += added;
+}
+
+void HashMap::parallelForEach(const std::function<void(TKey, TVal &)> &fn,
+                              size_t numThreads) {
+  if (!buckets) {
+    for (int i = 0; i < size; i++)
+      fn(smallKeys[i], smallValues[i]);
+    return;
+  }
+  size_t partitions = resolveThreads(numThreads, bucketsSize);
+  ThreadPool pool(partitions);
+  runPartitions(pool, partitions, [&](size_t partition) {
+    int end = partitionBegin(partition + 1, partitions, bucketsSize);
+    for (int i = partitionBegin(partition, partitions, bucketsSize); i < end;
+         i++) {
+      for (auto node = buckets[i]; node; node = node->next)
+        fn(node->key, node->value);
+    }
+  });
+}
+
+int HashMap::parallelEraseIf(
+    const std::function<bool(TKey, const TVal &)> &pred, size_t numThreads) {
+  if (!buckets) {
+    int removed = 0;
+    for (int i = 0; i < size;) {
+      if (pred(smallKeys[i], smallValues[i])) {
+        size--;
+        smallKeys[i] = smallKeys[size];
+        smallValues[i] = std::move(smallValues[size]);
+        smallValues[size] = TVal();
+        removed++;
+      } else {
+        i++;
+      }
+    }
+    return removed;
+  }
+  size_t partitions = resolveThreads(numThreads, bucketsSize);
+  std::pmr::vector<int> erased(partitions, 0, resource);
+  SpinLock resourceLock;
+  ThreadPool pool(partitions);
+  runPartitions(pool, partitions, [&](size_t partition) {
+    int removed = 0;
+    int end = partitionBegin(partition + 1, partitions, bucketsSize);
+    for (int i = partitionBegin(partition, partitions, bucketsSize); i < end;
+         i++) {
+      auto link = &buckets[i];
+      while (*link) {
+        auto node = *link;
+        if (pred(node->key, node->value)) {
+          *link = node->next;
+          ResourceGuard guard(resource, resourceLock);
+          destroyNode(node);
+          removed++;
+        } else {
+          link = &node->next;
+        }
+      }
+    }
+    erased[partition] = removed;
+  });
+
+  int removed = 0;
+  for (int count : erased)
+    removed += count;
+  size -= removed;
+  return removed;
+}
+
+void HashMap::parallelRehash(int capacity, size_t numThreads) {
+  int newSize = roundCapacity(capacity);
+  if (!buckets) {
+    bucketsSize = newSize;
+    return;
+  }
+  size_t partitions = resolveThreads(numThreads, std::min(bucketsSize, newSize));
+  auto fresh = allocateBuckets(newSize);
+
+  // Фаза 1: потоки обходят свои диапазоны старого массива и раскладывают
+  // узлы по разделам нового. Фаза 2: каждый поток перецепляет свой раздел
+  std::pmr::vector<
+      std::pmr::vector<std::pmr::vector<std::pair<LinkedList *, int>>>>
+      scatter(resource);
+  scatter.resize(partitions);
+  for (auto &row : scatter)
+    row.resize(partitions);
+  SpinLock resourceLock;
+  ThreadPool pool(partitions);
+
+  runPartitions(pool, partitions, [&](size_t worker) {
+    int end = partitionBegin(worker + 1, partitions, bucketsSize);
+    for (int i = partitionBegin(worker, partitions, bucketsSize); i < end; i++) {
+      for (auto node = buckets[i]; node; node = node->next) {
+        int hash = hashFunction(node->key, newSize);
+        appendGuarded(scatter[worker][partitionOf(hash, partitions, newSize)],
+                      std::pair<LinkedList *, int>(node, hash), resource,
+                      resourceLock);
+      }
+    }
+  });
+
+  runPartitions(pool, partitions, [&](size_t partition) {
+    for (size_t worker = 0; worker < partitions; worker++) {
+      for (auto [node, hash] : scatter[worker][partition]) {
+        node->next = fresh[hash];
+        fresh[hash] = node;
+      }
+    }
+  });
+
+  deallocateBuckets(buckets, bucketsSize);
+  buckets = fresh;
+  bucketsSize = newSize;
+}
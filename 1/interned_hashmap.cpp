@@ -0,0 +1,182 @@
+#include "interned_hashmap.h"
+#include "hashers.h"
+#include <functional>
+
+static uint64_t contentHash(std::string_view content) {
+  return std::hash<std::string_view>{}(content);
+}
+
+static bool sameContent(const InternedValue *value, std::string_view content) {
+  if (!value->prefix)
+    return content == value->tail;
+  std::string_view prefix = value->prefix->tail;
+  return content.size() == prefix.size() + value->tail.size() &&
+         content.starts_with(prefix) &&
+         content.substr(prefix.size()) == value->tail;
+}
+
+ValueInterner::ValueInterner() : storedBytes(0) {}
+
+ValueInterner::~ValueInterner() {
+  for (auto &[hash, value] : table)
+    delete value;
+}
+
+InternedValue *ValueInterner::find(std::string_view content, uint64_t hash) {
+  auto [begin, end] = table.equal_range(hash);
+  for (auto it = begin; it != end; ++it)
+    if (sameContent(it->second, content))
+      return it->second;
+  return nullptr;
+}
+
+InternedValue *ValueInterner::insert(std::string_view content, uint64_t hash,
+                                     InternedValue *prefix,
+                                     size_t prefixLength) {
+  auto value = new InternedValue{1, hash, prefix,
+                                 std::string(content.substr(prefixLength))};
+  table.emplace(hash, value);
+  storedBytes += value->tail.size();
+  return value;
+}
+
+InternedValue *ValueInterner::intern(std::string_view content) {
+  uint64_t hash = contentHash(content);
+  if (auto existing = find(content, hash)) {
+    existing->refs++;
+    return existing;
+  }
+
+  size_t prefixLength = content.size() / INTERN_PREFIX_BLOCK * INTERN_PREFIX_BLOCK;
+  if (prefixLength == 0 || prefixLength == content.size())
+    return insert(content, hash, nullptr, 0);
+
+  std::string_view prefixContent = content.substr(0, prefixLength);
+  uint64_t prefixHash = contentHash(prefixContent);
+  auto prefix = find(prefixContent, prefixHash);
+  if (prefix)
+    prefix->refs++;
+  else
+    prefix = insert(prefixContent, prefixHash, nullptr, 0);
+  return insert(content, hash, prefix, prefixLength);
+}
+
+void ValueInterner::release(InternedValue *value) {
+  if (--value->refs > 0)
+    return;
+  auto [begin, end] = table.equal_range(value->hash);
+  for (auto it = begin; it != end; ++it) {
+    if (it->second == value) {
+      table.erase(it);
+      break;
+    }
+  }
+  storedBytes -= value->tail.size();
+  if (value->prefix)
+    release(value->prefix);
+  delete value;
+}
+
+uint64_t ValueInterner::getStoredBytes() { return storedBytes; }
+
+int ValueInterner::getUniqueCount() { return table.size(); }
+
+TVal ValueInterner::materialize(const InternedValue *value) {
+  if (!value->prefix)
+    return value->tail;
+  TVal result;
+  result.reserve(value->prefix->tail.size() + value->tail.size());
+  result.append(value->prefix->tail);
+  result.append(value->tail);
+  return result;
+}
+
+InternedHashMap::InternedHashMap(int capacity)
+    : InternedHashMap(capacity, getDefaultHashFunction()) {}
+
+InternedHashMap::InternedHashMap(int capacity, THashFunction hf)
+    : buckets(new InternedNode *[roundCapacity(capacity)]),
+      bucketsSize(roundCapacity(capacity)), size(0), hashFunction(hf),
+      logicalBytes(0) {
+  std::fill(buckets, buckets + bucketsSize, nullptr);
+}
+
+InternedHashMap::~InternedHashMap() {
+  for (int i = 0; i < bucketsSize; i++) {
+    auto node = buckets[i];
+    while (node) {
+      auto next = node->next;
+      interner.release(node->value);
+      delete node;
+      node = next;
+    }
+  }
+  delete[] buckets;
+}
+
+static size_t valueLength(const InternedValue *value) {
+  return value->tail.size() + (value->prefix ? value->prefix->tail.size() : 0);
+}
+
+std::optional<TVal> InternedHashMap::remove(TKey key) {
+  int hash = hashFunction(key, bucketsSize);
+  InternedNode *prev = nullptr;
+  auto curr = buckets[hash];
+  while (curr && curr->key != key) {
+    prev = curr;
+    curr = curr->next;
+  }
+  if (!curr)
+    return std::nullopt;
+  if (prev)
+    prev->next = curr->next;
+  else
+    buckets[hash] = curr->next;
+  TVal value = ValueInterner::materialize(curr->value);
+  logicalBytes -= value.size();
+  interner.release(curr->value);
+  delete curr;
+  size--;
+  return value;
+}
+
+bool InternedHashMap::has(TKey key) {
+  auto node = buckets[hashFunction(key, bucketsSize)];
+  while (node && node->key != key)
+    node = node->next;
+  return node != nullptr;
+}
+
+void InternedHashMap::set(TKey key, const TVal &val) {
+  int hash = hashFunction(key, bucketsSize);
+  auto node = buckets[hash];
+  while (node && node->key != key)
+    node = node->next;
+  auto value = interner.intern(val);
+  logicalBytes += val.size();
+  if (node) {
+    logicalBytes -= valueLength(node->value);
+    interner.release(node->value);
+    node->value = value;
+    return;
+  }
+  buckets[hash] = new InternedNode{buckets[hash], key, value};
+  size++;
+}
+
+int InternedHashMap::getSize() { return size; }
+
+std::optional<TVal> InternedHashMap::get(TKey key) {
+  auto node = buckets[hashFunction(key, bucketsSize)];
+  while (node && node->key != key)
+    node = node->next;
+  if (!node)
+    return std::nullopt;
+  return ValueInterner::materialize(node->value);
+}
+
+uint64_t InternedHashMap::getLogicalBytes() { return logicalBytes; }
+
+uint64_t InternedHashMap::getStoredBytes() { return interner.getStoredBytes(); }
+
+int InternedHashMap::getUniqueValues() { return interner.getUniqueCount(); }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "hashmap.h"
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+constexpr size_t INTERN_PREFIX_BLOCK = 64;
+
+// Значение = (общий префикс) + хвост; одинаковые значения делят один буфер,
+// похожие — один префикс
+struct InternedValue {
+  uint32_t refs;
+  uint64_t hash;
+  InternedValue *prefix;
+  std::string tail;
+};
+
+struct InternedNode {
+  InternedNode *next;
+  TKey key;
+  InternedValue *value;
+};
+
+class ValueInterner {
+private:
+  std::unordered_multimap<uint64_t, InternedValue *> table;
+  uint64_t storedBytes;
+
+  InternedValue *find(std::string_view content, uint64_t hash);
+  InternedValue *insert(std::string_view content, uint64_t hash,
+                        InternedValue *prefix, size_t prefixLength);
+
+public:
+  ValueInterner();
+
+  ~ValueInterner();
+
+  InternedValue *intern(std::string_view content);
+
+  void release(InternedValue *value);
+
+  uint64_t getStoredBytes();
+
+  int getUniqueCount();
+
+  static TVal materialize(const InternedValue *value);
+};
+
+class InternedHashMap {
+private:
+  InternedNode **buckets;
+  int bucketsSize;
+  int size;
+  THashFunction hashFunction;
+  ValueInterner interner;
+  uint64_t logicalBytes;
+
+public:
+  InternedHashMap(int capacity);
+
+  InternedHashMap(int capacity, THashFunction hf);
+
+  ~InternedHashMap();
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, const TVal &val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+
+  // Суммарный размер значений, как если бы каждое хранилось целиком
+  uint64_t getLogicalBytes();
+
+  uint64_t getStoredBytes();
+
+  int getUniqueValues();
+};
@@ -0,0 +1,218 @@
+#include "kv_protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Нагрузочный клиент для kv_server: для каждой комбинации числа соединений
+// и глубины конвейера гоняет замкнутый цикл (отправить depth запросов,
+// дождаться depth ответов) и печатает пропускную способность и перцентили
+// задержки. Задержка запроса - от отправки пачки до получения его ответа
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string socket = KV_DEFAULT_SOCKET;
+  std::vector<int> connections = {1, 4, 16};
+  std::vector<int> depths = {1, 8, 64};
+  int requests = 100000;
+  int keys = 100000;
+  int valueSize = 100;
+  double getRatio = 0.9;
+};
+
+static std::vector<int> parseList(const char *text) {
+  std::vector<int> values;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ','))
+    values.push_back(atoi(item.c_str()));
+  return values;
+}
+
+static Options parseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--socket"))
+      options.socket = argv[i + 1];
+    else if (!strcmp(argv[i], "--connections"))
+      options.connections = parseList(argv[i + 1]);
+    else if (!strcmp(argv[i], "--depth"))
+      options.depths = parseList(argv[i + 1]);
+    else if (!strcmp(argv[i], "--requests"))
+      options.requests = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--keys"))
+      options.keys = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--value-size"))
+      options.valueSize = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--get-ratio"))
+      options.getRatio = atof(argv[i + 1]);
+    else {
+      fprintf(stderr,
+              "usage: %s [--socket path] [--connections 1,4,16] "
+              "[--depth 1,8,64] [--requests N] [--keys N] [--value-size N] "
+              "[--get-ratio 0.9]\n",
+              argv[0]);
+      exit(1);
+    }
+  }
+  // Глубина 0 не продвинула бы цикл запросов, а без соединений нечего мерить
+  for (auto *list : {&options.connections, &options.depths}) {
+    for (int value : *list) {
+      if (value < 1) {
+        fprintf(stderr, "--connections and --depth must be positive\n");
+        exit(1);
+      }
+    }
+  }
+  return options;
+}
+
+static int connectTo(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    perror(("connect " + path).c_str());
+    exit(1);
+  }
+  return fd;
+}
+
+static void sendAll(int fd, const std::string &data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t sent =
+        send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+    if (sent <= 0) {
+      perror("send");
+      exit(1);
+    }
+    offset += sent;
+  }
+}
+
+// Читает count ответов, вызывая onResponse(i) по мере их прихода
+template <typename Fn>
+static void receive(int fd, std::string &buffer, int count, Fn onResponse) {
+  char chunk[64 << 10];
+  int received = 0;
+  while (received < count) {
+    size_t offset = 0;
+    KvStatus status;
+    uint32_t length;
+    size_t size;
+    while (received < count &&
+           (size = parseResponse(buffer.data() + offset,
+                                 buffer.size() - offset, status, length)) > 0) {
+      if (status == KvStatus::Error) {
+        fprintf(stderr, "server returned an error\n");
+        exit(1);
+      }
+      offset += size;
+      onResponse(received++);
+    }
+    buffer.erase(0, offset);
+    if (received == count)
+      break;
+    ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+    if (got <= 0) {
+      fprintf(stderr, "connection closed by server\n");
+      exit(1);
+    }
+    buffer.append(chunk, got);
+  }
+}
+
+static void preload(const Options &options) {
+  constexpr int BATCH = 256;
+  int fd = connectTo(options.socket);
+  std::string value(options.valueSize, 'v');
+  std::string request, buffer;
+  for (int key = 0; key < options.keys; key += BATCH) {
+    int count = std::min(BATCH, options.keys - key);
+    request.clear();
+    for (int i = 0; i < count; i++)
+      appendRequest(request, KvOp::Set, key + i, value);
+    sendAll(fd, request);
+    receive(fd, buffer, count, [](int) {});
+  }
+  close(fd);
+}
+
+static void runConnection(const Options &options, int depth, int seed,
+                          std::vector<double> &latencies) {
+  int fd = connectTo(options.socket);
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> keys(0, options.keys - 1);
+  std::bernoulli_distribution isGet(options.getRatio);
+  std::string value(options.valueSize, 'w');
+  std::string request, buffer;
+  latencies.reserve(options.requests);
+  for (int done = 0; done < options.requests; done += depth) {
+    int count = std::min(depth, options.requests - done);
+    request.clear();
+    for (int i = 0; i < count; i++) {
+      if (isGet(rng))
+        appendRequest(request, KvOp::Get, keys(rng));
+      else
+        appendRequest(request, KvOp::Set, keys(rng), value);
+    }
+    auto start = Clock::now();
+    sendAll(fd, request);
+    receive(fd, buffer, count, [&](int) {
+      latencies.push_back(
+          std::chrono::duration<double, std::micro>(Clock::now() - start)
+              .count());
+    });
+  }
+  close(fd);
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t index = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+  return sorted[index];
+}
+
+int main(int argc, char **argv) {
+  Options options = parseOptions(argc, argv);
+  preload(options);
+
+  printf("%6s %6s %14s %10s %10s %10s %10s %10s\n", "conns", "depth",
+         "req/s", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+  for (int connections : options.connections) {
+    for (int depth : options.depths) {
+      std::vector<std::vector<double>> latencies(connections);
+      std::vector<std::thread> threads;
+      auto start = Clock::now();
+      for (int c = 0; c < connections; c++)
+        threads.emplace_back(runConnection, std::cref(options), depth, c,
+                             std::ref(latencies[c]));
+      for (auto &thread : threads)
+        thread.join();
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+
+      std::vector<double> all;
+      for (auto &local : latencies)
+        all.insert(all.end(), local.begin(), local.end());
+      std::sort(all.begin(), all.end());
+      printf("%6d %6d %14.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+             connections, depth, all.size() / seconds, percentile(all, 0.5),
+             percentile(all, 0.9), percentile(all, 0.99),
+             percentile(all, 0.999), all.empty() ? 0 : all.back());
+    }
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "hashmap.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Бинарный протокол kv_server. Запросы и ответы идут потоком без
+// разделителей, клиент может отправить сколько угодно запросов подряд
+// (pipelining), ответы приходят в том же порядке. Порядок байт -
+// нативный: сокет локальный.
+//
+// Запрос:  op (1 байт) | key (4 байта) | length (4 байта) | value (SET)
+// Ответ:   status (1 байт) | length (4 байта) | value (GET)
+
+enum class KvOp : uint8_t { Get = 1, Set = 2, Del = 3 };
+
+enum class KvStatus : uint8_t { Ok = 0, NotFound = 1, Error = 2 };
+
+constexpr size_t KV_REQUEST_HEADER = 9;
+constexpr size_t KV_RESPONSE_HEADER = 5;
+constexpr uint32_t KV_MAX_VALUE = 64 << 20;
+constexpr const char *KV_DEFAULT_SOCKET = "/tmp/hashmap.sock";
+
+struct KvRequest {
+  KvOp op;
+  TKey key;
+  uint32_t length;
+  const char *value;
+};
+
+inline void appendRequest(std::string &out, KvOp op, TKey key,
+                          const std::string &value = std::string()) {
+  char header[KV_REQUEST_HEADER];
+  uint32_t length = value.size();
+  header[0] = static_cast<char>(op);
+  std::memcpy(header + 1, &key, sizeof(key));
+  std::memcpy(header + 5, &length, sizeof(length));
+  out.append(header, sizeof(header));
+  out.append(value);
+}
+
+inline void appendResponse(std::string &out, KvStatus status,
+                           const char *value = nullptr, uint32_t length = 0) {
+  char header[KV_RESPONSE_HEADER];
+  header[0] = static_cast<char>(status);
+  std::memcpy(header + 1, &length, sizeof(length));
+  out.append(header, sizeof(header));
+  if (length)
+    out.append(value, length);
+}
+
+// Разбирает запрос в начале data; возвращает его размер, 0 если запрос
+// пришёл не полностью, или -1 если поток некорректен
+inline long parseRequest(const char *data, size_t size, KvRequest &request) {
+  if (size < KV_REQUEST_HEADER)
+    return 0;
+  request.op = static_cast<KvOp>(data[0]);
+  std::memcpy(&request.key, data + 1, sizeof(request.key));
+  std::memcpy(&request.length, data + 5, sizeof(request.length));
+  if (request.op != KvOp::Get && request.op != KvOp::Set &&
+      request.op != KvOp::Del)
+    return -1;
+  if (request.length > KV_MAX_VALUE ||
+      (request.op != KvOp::Set && request.length != 0))
+    return -1;
+  if (size < KV_REQUEST_HEADER + request.length)
+    return 0;
+  request.value = data + KV_REQUEST_HEADER;
+  return KV_REQUEST_HEADER + request.length;
+}
+
+// Разбирает ответ в начале data; возвращает его размер или 0, если он
+// пришёл не полностью
+inline size_t parseResponse(const char *data, size_t size, KvStatus &status,
+                            uint32_t &length) {
+  if (size < KV_RESPONSE_HEADER)
+    return 0;
+  status = static_cast<KvStatus>(data[0]);
+  std::memcpy(&length, data + 1, sizeof(length));
+  if (size < KV_RESPONSE_HEADER + length)
+    return 0;
+  return KV_RESPONSE_HEADER + length;
+}
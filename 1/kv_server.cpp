@@ -0,0 +1,210 @@
+#include "hashmap.h"
+#include "kv_protocol.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Однопоточный kv-сервер поверх HashMap на epoll. Все полные запросы,
+// пришедшие за одно чтение, обрабатываются пачкой: подряд идущие GET
+// собираются в один HashMap::getMany
+
+constexpr int MAX_EVENTS = 256;
+constexpr size_t READ_CHUNK = 64 << 10;
+// Пока клиент не забрал столько ответов, его запросы не читаются
+constexpr size_t MAX_PENDING_OUTPUT = 4 << 20;
+// Больше за одно событие не читается: остальное epoll (level-triggered)
+// вернёт в следующем круге, так что быстрый клиент не раздувает input и
+// не задерживает остальные соединения
+constexpr size_t MAX_READ_PER_EVENT = 4 * READ_CHUNK;
+
+struct Connection {
+  std::string input;
+  std::string output;
+  size_t outputOffset = 0;
+  uint32_t interest = EPOLLIN;
+  // Клиент закрыл свою сторону (shutdown(SHUT_WR)): запросов больше не будет,
+  // но ответы на уже прочитанные ещё нужно отправить
+  bool peerClosed = false;
+};
+
+static int listenSocket(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    perror("socket");
+    exit(1);
+  }
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "socket path is too long: %s\n", path);
+    exit(1);
+  }
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    perror("bind/listen");
+    exit(1);
+  }
+  return fd;
+}
+
+static void flushGets(HashMap &map, std::vector<TKey> &keys,
+                      std::string &output) {
+  if (keys.empty())
+    return;
+  for (auto &value : map.getMany(keys)) {
+    if (value)
+      appendResponse(output, KvStatus::Ok, value->data(), value->size());
+    else
+      appendResponse(output, KvStatus::NotFound);
+  }
+  keys.clear();
+}
+
+// Обрабатывает все полные запросы из input; false - поток некорректен
+static bool processInput(HashMap &map, Connection &conn,
+                         std::vector<TKey> &getKeys) {
+  size_t offset = 0;
+  KvRequest request;
+  long consumed;
+  while ((consumed = parseRequest(conn.input.data() + offset,
+                                  conn.input.size() - offset, request)) > 0) {
+    offset += consumed;
+    if (request.op == KvOp::Get) {
+      getKeys.push_back(request.key);
+      continue;
+    }
+    // SET/DEL меняют таблицу, поэтому накопленные GET выполняются до них
+    flushGets(map, getKeys, conn.output);
+    if (request.op == KvOp::Set) {
+      map.set(request.key, TVal(request.value, request.length));
+      appendResponse(conn.output, KvStatus::Ok);
+    } else {
+      bool removed = map.remove(request.key).has_value();
+      appendResponse(conn.output, removed ? KvStatus::Ok : KvStatus::NotFound);
+    }
+  }
+  flushGets(map, getKeys, conn.output);
+  conn.input.erase(0, offset);
+  return consumed >= 0;
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : KV_DEFAULT_SOCKET;
+  int capacity = argc > 2 ? atoi(argv[2]) : 1 << 20;
+  signal(SIGPIPE, SIG_IGN);
+
+  HashMap map(capacity);
+  map.reserveBuckets();
+  int listener = listenSocket(path);
+  int epoll = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = listener;
+  epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+  fprintf(stderr, "kv_server listening on %s\n", path);
+
+  std::unordered_map<int, Connection> connections;
+  std::vector<TKey> getKeys;
+  std::vector<char> buffer(READ_CHUNK);
+  epoll_event events[MAX_EVENTS];
+
+  auto closeConnection = [&](int fd) {
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+  };
+
+  auto updateInterest = [&](int fd, Connection &conn) {
+    size_t pending = conn.output.size() - conn.outputOffset;
+    uint32_t interest =
+        (!conn.peerClosed && pending < MAX_PENDING_OUTPUT ? uint32_t(EPOLLIN)
+                                                          : 0) |
+        (pending > 0 ? uint32_t(EPOLLOUT) : 0);
+    if (interest == conn.interest)
+      return;
+    conn.interest = interest;
+    epoll_event update{};
+    update.events = interest;
+    update.data.fd = fd;
+    epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &update);
+  };
+
+  while (true) {
+    int ready = epoll_wait(epoll, events, MAX_EVENTS, -1);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      return 1;
+    }
+    for (int i = 0; i < ready; i++) {
+      int fd = events[i].data.fd;
+      if (fd == listener) {
+        int client;
+        while ((client = accept4(listener, nullptr, nullptr,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          epoll_event added{};
+          added.events = EPOLLIN;
+          added.data.fd = client;
+          epoll_ctl(epoll, EPOLL_CTL_ADD, client, &added);
+          connections[client];
+        }
+        continue;
+      }
+
+      auto &conn = connections[fd];
+      bool alive = !(events[i].events & EPOLLERR);
+      if (alive && !conn.peerClosed && (conn.interest & EPOLLIN) &&
+          (events[i].events & (EPOLLIN | EPOLLHUP))) {
+        for (size_t read = 0; read < MAX_READ_PER_EVENT;) {
+          ssize_t got = recv(fd, buffer.data(), buffer.size(), 0);
+          if (got > 0) {
+            conn.input.append(buffer.data(), got);
+            read += got;
+            if (size_t(got) < buffer.size())
+              break;
+          } else {
+            if (got == 0)
+              conn.peerClosed = true;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+              alive = false;
+            break;
+          }
+        }
+        if (!processInput(map, conn, getKeys))
+          alive = false;
+      }
+      while (alive && conn.outputOffset < conn.output.size()) {
+        ssize_t sent = send(fd, conn.output.data() + conn.outputOffset,
+                            conn.output.size() - conn.outputOffset,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+            alive = false;
+          break;
+        }
+        conn.outputOffset += sent;
+      }
+      bool flushed = conn.outputOffset == conn.output.size();
+      if (!alive || (conn.peerClosed && flushed)) {
+        closeConnection(fd);
+        continue;
+      }
+      if (flushed) {
+        conn.output.clear();
+        conn.outputOffset = 0;
+      }
+      updateInterest(fd, conn);
+    }
+  }
+}
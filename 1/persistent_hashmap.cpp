@@ -0,0 +1,147 @@
+#include "persistent_hashmap.h"
+#include "hashers.h"
+#include <atomic>
+
+static int pageCount(int bucketsSize) {
+  return (bucketsSize + PERSISTENT_PAGE_SIZE - 1) / PERSISTENT_PAGE_SIZE;
+}
+
+// Копирует цепочку до узла с key; value == nullptr означает удаление узла
+static PersistentNodePtr copyPath(const PersistentNodePtr &node, TKey key,
+                                  std::shared_ptr<const TVal> value) {
+  if (node->key == key) {
+    if (!value)
+      return node->next;
+    return std::make_shared<PersistentNode>(
+        PersistentNode{node->next, key, std::move(value)});
+  }
+  return std::make_shared<PersistentNode>(PersistentNode{
+      copyPath(node->next, key, std::move(value)), node->key, node->value});
+}
+
+HashMapSnapshot::HashMapSnapshot(
+    std::vector<std::shared_ptr<const BucketPage>> pages, int bucketsSize,
+    int size, THashFunction hf)
+    : pages(std::move(pages)), bucketsSize(bucketsSize), size(size),
+      hashFunction(hf) {}
+
+const PersistentNode *HashMapSnapshot::find(TKey key) const {
+  int hash = hashFunction(key, bucketsSize);
+  auto node = pages[hash / PERSISTENT_PAGE_SIZE]
+                  ->buckets[hash % PERSISTENT_PAGE_SIZE]
+                  .get();
+  while (node && node->key != key)
+    node = node->next.get();
+  return node;
+}
+
+bool HashMapSnapshot::has(TKey key) const { return find(key) != nullptr; }
+
+int HashMapSnapshot::getSize() const { return size; }
+
+std::optional<TVal> HashMapSnapshot::get(TKey key) const {
+  auto node = find(key);
+  if (!node)
+    return std::nullopt;
+  return *node->value;
+}
+
+PersistentHashMap::PersistentHashMap(int capacity)
+    : PersistentHashMap(capacity, getDefaultHashFunction()) {}
+
+PersistentHashMap::PersistentHashMap(int capacity, THashFunction hf)
+    : bucketsSize(roundCapacity(capacity)), size(0), hashFunction(hf) {
+  pages.reserve(pageCount(bucketsSize));
+  for (int i = 0; i < pageCount(bucketsSize); i++)
+    pages.push_back(std::make_shared<BucketPage>());
+}
+
+const PersistentNodePtr &PersistentHashMap::bucket(int hash) {
+  return pages[hash / PERSISTENT_PAGE_SIZE]->buckets[hash % PERSISTENT_PAGE_SIZE];
+}
+
+PersistentNodePtr &PersistentHashMap::bucketForWrite(int hash) {
+  auto &page = pages[hash / PERSISTENT_PAGE_SIZE];
+  if (page.use_count() > 1)
+    page = std::make_shared<BucketPage>(*page);
+  else
+    std::atomic_thread_fence(std::memory_order_acquire);
+  return page->buckets[hash % PERSISTENT_PAGE_SIZE];
+}
+
+// Узел можно менять на месте, только если весь путь до него принадлежит
+// живой таблице и не виден ни одному снапшоту
+static bool uniquePath(const PersistentNodePtr &head, TKey key) {
+  for (auto link = &head; *link; link = &(*link)->next) {
+    if (link->use_count() != 1)
+      return false;
+    if ((*link)->key == key)
+      break;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return true;
+}
+
+std::optional<TVal> PersistentHashMap::remove(TKey key) {
+  std::lock_guard guard(lock);
+  int hash = hashFunction(key, bucketsSize);
+  auto node = bucket(hash).get();
+  while (node && node->key != key)
+    node = node->next.get();
+  if (!node)
+    return std::nullopt;
+  TVal value = *node->value;
+  auto &head = bucketForWrite(hash);
+  head = copyPath(head, key, nullptr);
+  size--;
+  return value;
+}
+
+bool PersistentHashMap::has(TKey key) {
+  std::lock_guard guard(lock);
+  auto node = bucket(hashFunction(key, bucketsSize)).get();
+  while (node && node->key != key)
+    node = node->next.get();
+  return node != nullptr;
+}
+
+void PersistentHashMap::set(TKey key, TVal val) {
+  std::lock_guard guard(lock);
+  int hash = hashFunction(key, bucketsSize);
+  auto &head = bucketForWrite(hash);
+  auto node = head.get();
+  while (node && node->key != key)
+    node = node->next.get();
+  auto value = std::make_shared<const TVal>(std::move(val));
+  if (!node) {
+    head = std::make_shared<PersistentNode>(
+        PersistentNode{head, key, std::move(value)});
+    size++;
+  } else if (uniquePath(head, key)) {
+    const_cast<PersistentNode *>(node)->value = std::move(value);
+  } else {
+    head = copyPath(head, key, std::move(value));
+  }
+}
+
+int PersistentHashMap::getSize() {
+  std::lock_guard guard(lock);
+  return size;
+}
+
+std::optional<TVal> PersistentHashMap::get(TKey key) {
+  std::lock_guard guard(lock);
+  auto node = bucket(hashFunction(key, bucketsSize)).get();
+  while (node && node->key != key)
+    node = node->next.get();
+  if (!node)
+    return std::nullopt;
+  return *node->value;
+}
+
+std::shared_ptr<const HashMapSnapshot> PersistentHashMap::snapshot() {
+  std::lock_guard guard(lock);
+  return std::make_shared<const HashMapSnapshot>(
+      std::vector<std::shared_ptr<const BucketPage>>(pages.begin(), pages.end()),
+      bucketsSize, size, hashFunction);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "hashmap.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+constexpr int PERSISTENT_PAGE_SIZE = 128;
+
+// Значение вынесено в отдельный shared_ptr, чтобы копирование пути
+// не копировало строки предшественников
+struct PersistentNode {
+  std::shared_ptr<const PersistentNode> next;
+  TKey key;
+  std::shared_ptr<const TVal> value;
+};
+
+using PersistentNodePtr = std::shared_ptr<const PersistentNode>;
+
+// Страница бакетов — единица copy-on-write: снапшот делит страницы и узлы
+// с живой таблицей, пока писатель их не изменит
+struct BucketPage {
+  PersistentNodePtr buckets[PERSISTENT_PAGE_SIZE];
+};
+
+class HashMapSnapshot {
+private:
+  std::vector<std::shared_ptr<const BucketPage>> pages;
+  int bucketsSize;
+  int size;
+  THashFunction hashFunction;
+
+  const PersistentNode *find(TKey key) const;
+
+public:
+  HashMapSnapshot(std::vector<std::shared_ptr<const BucketPage>> pages,
+                  int bucketsSize, int size, THashFunction hf);
+
+  bool has(TKey key) const;
+
+  int getSize() const;
+
+  std::optional<TVal> get(TKey key) const;
+};
+
+class PersistentHashMap {
+private:
+  std::vector<std::shared_ptr<BucketPage>> pages;
+  int bucketsSize;
+  int size;
+  THashFunction hashFunction;
+  std::mutex lock;
+
+  PersistentNodePtr &bucketForWrite(int hash);
+  const PersistentNodePtr &bucket(int hash);
+
+public:
+  PersistentHashMap(int capacity);
+
+  PersistentHashMap(int capacity, THashFunction hf);
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, TVal val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+
+  // O(capacity / PERSISTENT_PAGE_SIZE): копируются только указатели на страницы
+  std::shared_ptr<const HashMapSnapshot> snapshot();
+};
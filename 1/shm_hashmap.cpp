@@ -0,0 +1,270 @@
+#include "shm_hashmap.h"
+#include "hashers.h"
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+constexpr uint64_t SHM_MAGIC = 0x50414d4853534148ull;
+constexpr uint64_t SHM_MIN_BLOCK = 64;
+constexpr int SHM_MAX_CHAIN = 1 << 20;
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void ShmSpinLock::lock() {
+  while (flag.exchange(1, std::memory_order_acquire)) {
+    while (flag.load(std::memory_order_relaxed)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void ShmSpinLock::unlock() { flag.store(0, std::memory_order_release); }
+
+static char *mapSegment(int fd, uint64_t size, const std::string &name) {
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    int error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "mmap " + name);
+  }
+  close(fd);
+  return static_cast<char *>(addr);
+}
+
+ShmHashMap::ShmHashMap(const std::string &name, int capacity,
+                       uint64_t segmentSize)
+    : name(name) {
+  int bucketsSize = roundCapacity(capacity);
+  uint64_t bucketsOffset = alignUp(sizeof(ShmHeader), 64);
+  uint64_t dataOffset =
+      alignUp(bucketsOffset + bucketsSize * sizeof(uint64_t), 64);
+  if (segmentSize < dataOffset + SHM_MIN_BLOCK)
+    throw std::invalid_argument("shm segment is too small for " +
+                                std::to_string(bucketsSize) + " buckets");
+
+  // Старый сегмент не обрезается, а отвязывается: процессы, которые его ещё
+  // отображают, дорабатывают со старой памятью, а новый объект создаётся
+  // с O_EXCL и после ftruncate уже заполнен нулями
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+  if (ftruncate(fd, segmentSize) < 0) {
+    int error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+  }
+  base = mapSegment(fd, segmentSize, name);
+  mappedSize = segmentSize;
+
+  header = new (base) ShmHeader{};
+  header->segmentSize = segmentSize;
+  header->bucketsOffset = bucketsOffset;
+  header->bucketsSize = bucketsSize;
+  header->bumpOffset = dataOffset;
+  buckets = reinterpret_cast<std::atomic<uint64_t> *>(base + bucketsOffset);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SHM_MAGIC;
+}
+
+ShmHashMap::ShmHashMap(const std::string &name) : name(name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    int error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "fstat " + name);
+  }
+  base = mapSegment(fd, info.st_size, name);
+  mappedSize = info.st_size;
+  header = reinterpret_cast<ShmHeader *>(base);
+  if (mappedSize < sizeof(ShmHeader) || header->magic != SHM_MAGIC ||
+      header->segmentSize != mappedSize) {
+    munmap(base, mappedSize);
+    throw std::runtime_error("shm segment " + name + " is not a ShmHashMap");
+  }
+  buckets =
+      reinterpret_cast<std::atomic<uint64_t> *>(base + header->bucketsOffset);
+}
+
+ShmHashMap::~ShmHashMap() { munmap(base, mappedSize); }
+
+void ShmHashMap::unlink(const std::string &name) { shm_unlink(name.c_str()); }
+
+ShmNode *ShmHashMap::node(uint64_t offset) {
+  return reinterpret_cast<ShmNode *>(base + offset);
+}
+
+// Читатель может увидеть полузаписанный узел, поэтому смещения проверяются
+// до разыменования, а результат — по seqlock
+bool ShmHashMap::validNode(uint64_t offset) {
+  return offset >= header->bucketsOffset && offset % alignof(ShmNode) == 0 &&
+         offset + sizeof(ShmNode) <= mappedSize;
+}
+
+uint64_t ShmHashMap::allocate(uint32_t length, uint32_t &sizeClass) {
+  uint64_t block = sizeof(ShmNode) + length;
+  sizeClass = 0;
+  while ((SHM_MIN_BLOCK << sizeClass) < block)
+    sizeClass++;
+  if (sizeClass >= SHM_SIZE_CLASSES)
+    throw std::length_error("value is too large for shm segment");
+
+  uint64_t offset = header->freeLists[sizeClass];
+  if (offset) {
+    header->freeLists[sizeClass] =
+        node(offset)->next.load(std::memory_order_relaxed);
+    return offset;
+  }
+  uint64_t size = SHM_MIN_BLOCK << sizeClass;
+  if (header->bumpOffset + size > header->segmentSize)
+    throw std::length_error("shm segment " + name + " is full");
+  offset = header->bumpOffset;
+  header->bumpOffset += size;
+  return offset;
+}
+
+void ShmHashMap::deallocate(uint64_t offset, uint32_t sizeClass) {
+  node(offset)->next.store(header->freeLists[sizeClass],
+                           std::memory_order_relaxed);
+  header->freeLists[sizeClass] = offset;
+}
+
+void ShmHashMap::beginWrite() {
+  header->writeLock.lock();
+  header->sequence.store(header->sequence.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void ShmHashMap::endWrite() {
+  header->sequence.store(header->sequence.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_release);
+  header->writeLock.unlock();
+}
+
+std::optional<TVal> ShmHashMap::remove(TKey key) {
+  WriteGuard guard(*this);
+  auto link = &buckets[reduceFibonacci(static_cast<uint32_t>(key),
+                                       header->bucketsSize)];
+  uint64_t offset = link->load(std::memory_order_relaxed);
+  while (offset && node(offset)->key != key) {
+    link = &node(offset)->next;
+    offset = link->load(std::memory_order_relaxed);
+  }
+  if (!offset)
+    return std::nullopt;
+  auto curr = node(offset);
+  TVal value(reinterpret_cast<char *>(curr + 1), curr->length);
+  link->store(curr->next.load(std::memory_order_relaxed),
+              std::memory_order_relaxed);
+  deallocate(offset, curr->sizeClass);
+  header->size.fetch_sub(1, std::memory_order_relaxed);
+  return value;
+}
+
+bool ShmHashMap::has(TKey key) {
+  int hash = reduceFibonacci(static_cast<uint32_t>(key), header->bucketsSize);
+  while (true) {
+    uint64_t before = header->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    bool found = false;
+    uint64_t offset = buckets[hash].load(std::memory_order_relaxed);
+    for (int steps = 0; offset && steps < SHM_MAX_CHAIN; steps++) {
+      if (!validNode(offset))
+        break;
+      if (node(offset)->key == key) {
+        found = true;
+        break;
+      }
+      offset = node(offset)->next.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->sequence.load(std::memory_order_relaxed) == before)
+      return found;
+  }
+}
+
+void ShmHashMap::set(TKey key, const TVal &val) {
+  WriteGuard guard(*this);
+  auto link = &buckets[reduceFibonacci(static_cast<uint32_t>(key),
+                                       header->bucketsSize)];
+  auto head = link;
+  uint64_t offset = link->load(std::memory_order_relaxed);
+  while (offset && node(offset)->key != key) {
+    link = &node(offset)->next;
+    offset = link->load(std::memory_order_relaxed);
+  }
+
+  if (offset &&
+      sizeof(ShmNode) + val.size() <= (SHM_MIN_BLOCK << node(offset)->sizeClass)) {
+    auto curr = node(offset);
+    std::memcpy(reinterpret_cast<char *>(curr + 1), val.data(), val.size());
+    curr->length = val.size();
+    return;
+  }
+
+  uint32_t sizeClass;
+  uint64_t fresh = allocate(val.size(), sizeClass);
+  auto created = node(fresh);
+  created->key = key;
+  created->length = val.size();
+  created->sizeClass = sizeClass;
+  std::memcpy(reinterpret_cast<char *>(created + 1), val.data(), val.size());
+  if (offset) {
+    created->next.store(node(offset)->next.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    link->store(fresh, std::memory_order_relaxed);
+    deallocate(offset, node(offset)->sizeClass);
+    return;
+  }
+  created->next.store(head->load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+  head->store(fresh, std::memory_order_relaxed);
+  header->size.fetch_add(1, std::memory_order_relaxed);
+}
+
+int ShmHashMap::getSize() {
+  return header->size.load(std::memory_order_relaxed);
+}
+
+std::optional<TVal> ShmHashMap::get(TKey key) {
+  int hash = reduceFibonacci(static_cast<uint32_t>(key), header->bucketsSize);
+  while (true) {
+    uint64_t before = header->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::optional<TVal> result;
+    uint64_t offset = buckets[hash].load(std::memory_order_relaxed);
+    for (int steps = 0; offset && steps < SHM_MAX_CHAIN; steps++) {
+      if (!validNode(offset))
+        break;
+      auto curr = node(offset);
+      if (curr->key == key) {
+        uint32_t length = curr->length;
+        if (length <= mappedSize - offset - sizeof(ShmNode))
+          result.emplace(reinterpret_cast<char *>(curr + 1), length);
+        break;
+      }
+      offset = curr->next.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->sequence.load(std::memory_order_relaxed) == before)
+      return result;
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "hashmap.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+constexpr int SHM_SIZE_CLASSES = 24;
+
+// Спинлок внутри сегмента: lock-free атомики работают между процессами
+struct ShmSpinLock {
+  std::atomic<uint32_t> flag;
+
+  void lock();
+  void unlock();
+};
+
+struct ShmHeader {
+  uint64_t magic;
+  uint64_t segmentSize;
+  uint64_t bucketsOffset;
+  int32_t bucketsSize;
+  std::atomic<int32_t> size;
+  ShmSpinLock writeLock;
+  std::atomic<uint64_t> sequence;
+  uint64_t bumpOffset;
+  uint64_t freeLists[SHM_SIZE_CLASSES];
+};
+
+// Узел и значение лежат в одном блоке; все ссылки — смещения от начала сегмента
+struct ShmNode {
+  std::atomic<uint64_t> next;
+  TKey key;
+  uint32_t length;
+  uint32_t sizeClass;
+};
+
+// Хэш-таблица с цепочками в POSIX shared memory. Писатели сериализуются
+// спинлоком в сегменте, читатели не блокируются и перечитывают по seqlock.
+// Хэш-функция фиксирована (по умолчанию), т.к. должна совпадать во всех процессах
+class ShmHashMap {
+private:
+  std::string name;
+  char *base;
+  uint64_t mappedSize;
+  ShmHeader *header;
+  std::atomic<uint64_t> *buckets;
+
+  ShmNode *node(uint64_t offset);
+  uint64_t allocate(uint32_t length, uint32_t &sizeClass);
+  void deallocate(uint64_t offset, uint32_t sizeClass);
+  bool validNode(uint64_t offset);
+  void beginWrite();
+  void endWrite();
+
+  class WriteGuard {
+    ShmHashMap &map;
+
+  public:
+    explicit WriteGuard(ShmHashMap &map) : map(map) { map.beginWrite(); }
+    ~WriteGuard() { map.endWrite(); }
+  };
+
+public:
+  // Создаёт сегмент name размером segmentSize байт; сегмент с тем же именем
+  // отвязывается, уже подключённые к нему процессы его не теряют
+  ShmHashMap(const std::string &name, int capacity, uint64_t segmentSize);
+
+  // Подключается к уже созданному сегменту
+  explicit ShmHashMap(const std::string &name);
+
+  ~ShmHashMap();
+
+  ShmHashMap(const ShmHashMap &) = delete;
+  ShmHashMap &operator=(const ShmHashMap &) = delete;
+
+  static void unlink(const std::string &name);
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, const TVal &val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+};
@@ -0,0 +1,249 @@
+#include "slab_hashmap.h"
+#include "hashers.h"
+#include <chrono>
+#include <cstring>
+
+static uint32_t recordSize(uint32_t length) {
+  return (sizeof(SlabRecord) + length + alignof(SlabRecord) - 1) &
+         ~(alignof(SlabRecord) - 1);
+}
+
+SlabHashMap::SlabHashMap(int capacity)
+    : SlabHashMap(capacity, getDefaultHashFunction()) {}
+
+SlabHashMap::SlabHashMap(int capacity, THashFunction hf)
+    : buckets(new SlabNode *[roundCapacity(capacity)]),
+      bucketsSize(roundCapacity(capacity)), size(0), hashFunction(hf),
+      head(0), usedBytes(0), liveBytes(0), compactorStop(false),
+      compactionThreshold(0.5) {
+  std::fill(buckets, buckets + bucketsSize, nullptr);
+  head = allocateSegment(SLAB_SEGMENT_SIZE);
+}
+
+SlabHashMap::~SlabHashMap() {
+  stopBackgroundCompaction();
+  for (int i = 0; i < bucketsSize; i++) {
+    auto node = buckets[i];
+    while (node) {
+      auto next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+  delete[] buckets;
+}
+
+uint32_t SlabHashMap::allocateSegment(uint32_t capacity) {
+  uint32_t index;
+  if (!freeSegments.empty()) {
+    index = freeSegments.back();
+    freeSegments.pop_back();
+  } else {
+    index = segments.size();
+    segments.push_back(SlabSegment{nullptr, 0, 0, 0});
+  }
+  auto &segment = segments[index];
+  if (!segment.data || segment.capacity < capacity) {
+    segment.data.reset(new char[capacity]);
+    segment.capacity = capacity;
+  }
+  segment.used = 0;
+  segment.liveBytes = 0;
+  return index;
+}
+
+void SlabHashMap::append(SlabNode *node, TKey key, const char *data,
+                         uint32_t length) {
+  uint32_t bytes = recordSize(length);
+  uint32_t target = head;
+  if (bytes > SLAB_SEGMENT_SIZE)
+    target = allocateSegment(bytes);
+  else if (segments[head].used + bytes > segments[head].capacity)
+    target = head = allocateSegment(SLAB_SEGMENT_SIZE);
+
+  auto &segment = segments[target];
+  char *record = segment.data.get() + segment.used;
+  SlabRecord header{key, length};
+  std::memcpy(record, &header, sizeof(header));
+  std::memcpy(record + sizeof(header), data, length);
+
+  node->segment = target;
+  node->offset = segment.used;
+  node->length = length;
+  segment.used += bytes;
+  segment.liveBytes += bytes;
+  usedBytes += bytes;
+  liveBytes += bytes;
+}
+
+void SlabHashMap::release(SlabNode *node) {
+  uint32_t bytes = recordSize(node->length);
+  auto &segment = segments[node->segment];
+  segment.liveBytes -= bytes;
+  liveBytes -= bytes;
+  if (segment.liveBytes == 0 && node->segment != head) {
+    usedBytes -= segment.used;
+    segment.used = 0;
+    if (segment.capacity > SLAB_SEGMENT_SIZE) {
+      segment.data.reset();
+      segment.capacity = 0;
+    }
+    freeSegments.push_back(node->segment);
+  }
+}
+
+SlabNode *SlabHashMap::find(TKey key, int hash) {
+  auto node = buckets[hash];
+  while (node && node->key != key)
+    node = node->next;
+  return node;
+}
+
+std::optional<TVal> SlabHashMap::remove(TKey key) {
+  std::lock_guard guard(lock);
+  int hash = hashFunction(key, bucketsSize);
+  SlabNode *prev = nullptr;
+  auto curr = buckets[hash];
+  while (curr && curr->key != key) {
+    prev = curr;
+    curr = curr->next;
+  }
+  if (!curr)
+    return std::nullopt;
+  if (prev)
+    prev->next = curr->next;
+  else
+    buckets[hash] = curr->next;
+  const char *data =
+      segments[curr->segment].data.get() + curr->offset + sizeof(SlabRecord);
+  TVal value(data, curr->length);
+  release(curr);
+  delete curr;
+  size--;
+  return value;
+}
+
+bool SlabHashMap::has(TKey key) {
+  std::lock_guard guard(lock);
+  return find(key, hashFunction(key, bucketsSize)) != nullptr;
+}
+
+void SlabHashMap::set(TKey key, const TVal &val) {
+  std::lock_guard guard(lock);
+  int hash = hashFunction(key, bucketsSize);
+  auto node = find(key, hash);
+  if (node) {
+    release(node);
+  } else {
+    node = new SlabNode{buckets[hash], key, 0, 0, 0};
+    buckets[hash] = node;
+    size++;
+  }
+  append(node, key, val.data(), val.size());
+}
+
+int SlabHashMap::getSize() { return size; }
+
+std::optional<TVal> SlabHashMap::get(TKey key) {
+  std::lock_guard guard(lock);
+  auto node = find(key, hashFunction(key, bucketsSize));
+  if (!node)
+    return std::nullopt;
+  const char *data =
+      segments[node->segment].data.get() + node->offset + sizeof(SlabRecord);
+  return TVal(data, node->length);
+}
+
+bool SlabHashMap::compactOne(double threshold) {
+  int victim = -1;
+  double worst = threshold;
+  for (uint32_t i = 0; i < segments.size(); i++) {
+    auto &segment = segments[i];
+    if (i == head || segment.used == 0)
+      continue;
+    double garbage = 1.0 - double(segment.liveBytes) / segment.used;
+    if (garbage > worst) {
+      worst = garbage;
+      victim = i;
+    }
+  }
+  if (victim < 0)
+    return false;
+
+  const char *base = segments[victim].data.get();
+  uint32_t used = segments[victim].used;
+  for (uint32_t offset = 0; offset < used;) {
+    SlabRecord header;
+    std::memcpy(&header, base + offset, sizeof(header));
+    auto node = find(header.key, hashFunction(header.key, bucketsSize));
+    if (node && node->segment == uint32_t(victim) && node->offset == offset) {
+      liveBytes -= recordSize(header.length);
+      append(node, header.key, base + offset + sizeof(header), header.length);
+    }
+    offset += recordSize(header.length);
+  }
+
+  auto &segment = segments[victim];
+  usedBytes -= segment.used;
+  segment.used = 0;
+  segment.liveBytes = 0;
+  freeSegments.push_back(victim);
+  return true;
+}
+
+int SlabHashMap::compact(double threshold) {
+  int freed = 0;
+  while (true) {
+    std::lock_guard guard(lock);
+    if (!compactOne(threshold))
+      break;
+    freed++;
+  }
+  return freed;
+}
+
+void SlabHashMap::compactorLoop() {
+  std::unique_lock guard(lock);
+  while (!compactorStop) {
+    if (compactOne(compactionThreshold)) {
+      // Отпускаем блокировку между сегментами, чтобы не задерживать писателей
+      guard.unlock();
+      std::this_thread::yield();
+      guard.lock();
+    } else {
+      compactionWakeup.wait_for(guard, std::chrono::milliseconds(50));
+    }
+  }
+}
+
+void SlabHashMap::startBackgroundCompaction(double threshold) {
+  std::lock_guard guard(lock);
+  if (compactor.joinable())
+    return;
+  compactionThreshold = threshold;
+  compactorStop = false;
+  compactor = std::thread(&SlabHashMap::compactorLoop, this);
+}
+
+void SlabHashMap::stopBackgroundCompaction() {
+  {
+    std::lock_guard guard(lock);
+    compactorStop = true;
+  }
+  compactionWakeup.notify_all();
+  if (compactor.joinable())
+    compactor.join();
+}
+
+uint64_t SlabHashMap::getSlabBytes() {
+  std::lock_guard guard(lock);
+  uint64_t bytes = 0;
+  for (auto &segment : segments)
+    bytes += segment.capacity;
+  return bytes;
+}
+
+uint64_t SlabHashMap::getLiveBytes() {
+  std::lock_guard guard(lock);
+  return liveBytes;
+}
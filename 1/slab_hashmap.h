@@ -0,0 +1,90 @@
+#pragma once
+
+#include "hashmap.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t SLAB_SEGMENT_SIZE = 1 << 20;
+
+struct SlabNode {
+  SlabNode *next;
+  TKey key;
+  uint32_t segment;
+  uint32_t offset;
+  uint32_t length;
+};
+
+// Заголовок записи в сегменте, по нему компакция находит владельца записи
+struct SlabRecord {
+  TKey key;
+  uint32_t length;
+};
+
+struct SlabSegment {
+  std::unique_ptr<char[]> data;
+  uint32_t capacity;
+  uint32_t used;
+  uint32_t liveBytes;
+};
+
+// Хэш-таблица с цепочками, у которой значения лежат в append-only сегментах,
+// а узлы хранят только (сегмент, смещение, длина)
+class SlabHashMap {
+private:
+  SlabNode **buckets;
+  int bucketsSize;
+  int size;
+  THashFunction hashFunction;
+
+  std::vector<SlabSegment> segments;
+  std::vector<uint32_t> freeSegments;
+  uint32_t head;
+  uint64_t usedBytes;
+  uint64_t liveBytes;
+
+  std::mutex lock;
+  std::condition_variable compactionWakeup;
+  std::thread compactor;
+  bool compactorStop;
+  double compactionThreshold;
+
+  SlabNode *find(TKey key, int hash);
+  void append(SlabNode *node, TKey key, const char *data, uint32_t length);
+  void release(SlabNode *node);
+  uint32_t allocateSegment(uint32_t capacity);
+  bool compactOne(double threshold);
+  void compactorLoop();
+
+public:
+  SlabHashMap(int capacity);
+
+  SlabHashMap(int capacity, THashFunction hf);
+
+  ~SlabHashMap();
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, const TVal &val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+
+  // Переносит живые записи из сегментов, где мусора больше threshold,
+  // возвращает количество освобождённых сегментов
+  int compact(double threshold = 0.5);
+
+  void startBackgroundCompaction(double threshold = 0.5);
+
+  void stopBackgroundCompaction();
+
+  uint64_t getSlabBytes();
+
+  uint64_t getLiveBytes();
+};
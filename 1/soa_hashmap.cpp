@@ -0,0 +1,74 @@
+#include "soa_hashmap.h"
+#include "hashers.h"
+
+constexpr int32_t NO_SLOT = -1;
+
+SoAHashMap::SoAHashMap(int capacity)
+    : SoAHashMap(capacity, getDefaultHashFunction()) {}
+
+SoAHashMap::SoAHashMap(int capacity, THashFunction hf)
+    : buckets(new int32_t[roundCapacity(capacity)]),
+      bucketsSize(roundCapacity(capacity)), size(0), hashFunction(hf),
+      freeSlot(NO_SLOT) {
+  std::fill(buckets, buckets + bucketsSize, NO_SLOT);
+}
+
+SoAHashMap::~SoAHashMap() { delete[] buckets; }
+
+int32_t SoAHashMap::find(TKey key, int hash) {
+  int32_t slot = buckets[hash];
+  while (slot != NO_SLOT && slots[slot].key != key)
+    slot = slots[slot].next;
+  return slot;
+}
+
+std::optional<TVal> SoAHashMap::remove(TKey key) {
+  int hash = hashFunction(key, bucketsSize);
+  int32_t *link = &buckets[hash];
+  while (*link != NO_SLOT && slots[*link].key != key)
+    link = &slots[*link].next;
+  if (*link == NO_SLOT)
+    return std::nullopt;
+  int32_t slot = *link;
+  *link = slots[slot].next;
+  TVal value = std::move(values[slot]);
+  values[slot] = TVal();
+  slots[slot].next = freeSlot;
+  freeSlot = slot;
+  size--;
+  return value;
+}
+
+bool SoAHashMap::has(TKey key) {
+  return find(key, hashFunction(key, bucketsSize)) != NO_SLOT;
+}
+
+void SoAHashMap::set(TKey key, TVal val) {
+  int hash = hashFunction(key, bucketsSize);
+  int32_t slot = find(key, hash);
+  if (slot != NO_SLOT) {
+    values[slot] = std::move(val);
+    return;
+  }
+  if (freeSlot != NO_SLOT) {
+    slot = freeSlot;
+    freeSlot = slots[slot].next;
+    slots[slot] = KeySlot{key, buckets[hash]};
+    values[slot] = std::move(val);
+  } else {
+    slot = slots.size();
+    slots.push_back(KeySlot{key, buckets[hash]});
+    values.push_back(std::move(val));
+  }
+  buckets[hash] = slot;
+  size++;
+}
+
+int SoAHashMap::getSize() { return size; }
+
+std::optional<TVal> SoAHashMap::get(TKey key) {
+  int32_t slot = find(key, hashFunction(key, bucketsSize));
+  if (slot == NO_SLOT)
+    return std::nullopt;
+  return values[slot];
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "hashmap.h"
+#include <cstdint>
+#include <vector>
+
+// Ключ и ссылка на следующий элемент цепочки — 8 байт, 8 слотов на кэш-линию
+struct KeySlot {
+  TKey key;
+  int32_t next;
+};
+
+// Хэш-таблица с цепочками в раскладке SoA: проход по цепочке читает только
+// плотный массив ключей, значения лежат в отдельном массиве с тем же индексом
+class SoAHashMap {
+private:
+  int32_t *buckets;
+  int bucketsSize;
+  int size;
+  THashFunction hashFunction;
+  std::vector<KeySlot> slots;
+  std::vector<TVal> values;
+  int32_t freeSlot;
+
+  int32_t find(TKey key, int hash);
+
+public:
+  SoAHashMap(int capacity);
+
+  SoAHashMap(int capacity, THashFunction hf);
+
+  ~SoAHashMap();
+
+  SoAHashMap(const SoAHashMap &) = delete;
+  SoAHashMap &operator=(const SoAHashMap &) = delete;
+
+  std::optional<TVal> remove(TKey key);
+
+  bool has(TKey key);
+
+  void set(TKey key, TVal val);
+
+  int getSize();
+
+  std::optional<TVal> get(TKey key);
+};
@@ -0,0 +1,246 @@
+#include "wal.h"
+#include "hashers.h"
+#include "write_batch.h"
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+constexpr uint32_t WAL_MAGIC = 0x4c415748;
+
+// Не криптографическая сумма, только для обнаружения оборванной записи:
+// по 8 байт за шаг, чтобы проверка не тормозила восстановление
+static uint64_t checksum(const char *data, size_t size) {
+  uint64_t hash = size * FIBONACCI_MULTIPLIER;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * FIBONACCI_MULTIPLIER;
+    hash ^= hash >> 32;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + i, size - i);
+  hash = (hash ^ tail) * FIBONACCI_MULTIPLIER;
+  return hash ^ (hash >> 29);
+}
+
+static void writeAll(int fd, const char *data, size_t size,
+                     const std::string &path) {
+  while (size) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::system_error(errno, std::generic_category(), "write " + path);
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string &path)
+    : path(path), appendedLsn(0), durableLsn(0), flushing(false),
+      failure(0) {
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    int error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "fstat " + path);
+  }
+  logBytes = info.st_size;
+  resetPending();
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  try {
+    sync();
+  } catch (...) {
+  }
+  close(fd);
+}
+
+void WriteAheadLog::resetPending() {
+  pending.assign(sizeof(WalBatchHeader), '\0');
+  batchStarts.assign(1, 0);
+}
+
+// Закрывает текущую пачку, если bytes в неё уже не помещаются
+void WriteAheadLog::reserveRecord(size_t bytes) {
+  if (bytes > WAL_MAX_BATCH)
+    throw std::length_error("wal record is too large for " + path);
+  size_t used = pending.size() - batchStarts.back() - sizeof(WalBatchHeader);
+  if (used + bytes > WAL_MAX_BATCH) {
+    batchStarts.push_back(pending.size());
+    pending.append(sizeof(WalBatchHeader), '\0');
+  }
+}
+
+uint64_t WriteAheadLog::replay(
+    const std::function<void(WalOp, TKey, const char *, uint32_t)> &fn) {
+  std::lock_guard guard(lock);
+  if (logBytes == 0)
+    return 0;
+  void *addr = mmap(nullptr, logBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED)
+    throw std::system_error(errno, std::generic_category(), "mmap " + path);
+  madvise(addr, logBytes, MADV_SEQUENTIAL);
+  auto data = static_cast<const char *>(addr);
+
+  uint64_t records = 0;
+  uint64_t offset = 0;
+  while (offset + sizeof(WalBatchHeader) <= logBytes) {
+    WalBatchHeader header;
+    std::memcpy(&header, data + offset, sizeof(header));
+    const char *batch = data + offset + sizeof(header);
+    if (header.magic != WAL_MAGIC ||
+        header.bytes > logBytes - offset - sizeof(header) ||
+        header.checksum != checksum(batch, header.bytes))
+      break;
+    // Пачка проверена целиком, поэтому записи внутри разбираются без
+    // повторных проверок границ, кроме длины значения
+    uint64_t position = 0;
+    while (position + WAL_RECORD_HEADER <= header.bytes) {
+      WalOp op = static_cast<WalOp>(batch[position]);
+      TKey key;
+      uint32_t length;
+      std::memcpy(&key, batch + position + 1, sizeof(key));
+      std::memcpy(&length, batch + position + 5, sizeof(length));
+      position += WAL_RECORD_HEADER;
+      if (length > header.bytes - position)
+        break;
+      fn(op, key, batch + position, length);
+      position += length;
+      records++;
+    }
+    offset += sizeof(header) + header.bytes;
+  }
+  munmap(addr, logBytes);
+
+  if (offset < logBytes) {
+    if (ftruncate(fd, offset) < 0)
+      throw std::system_error(errno, std::generic_category(),
+                              "ftruncate " + path);
+    logBytes = offset;
+  }
+  return records;
+}
+
+static void encodeRecord(std::string &out, WalOp op, TKey key,
+                         const TVal &value) {
+  char header[WAL_RECORD_HEADER];
+  uint32_t length = value.size();
+  header[0] = static_cast<char>(op);
+  std::memcpy(header + 1, &key, sizeof(key));
+  std::memcpy(header + 5, &length, sizeof(length));
+  out.append(header, sizeof(header));
+  out.append(value);
+}
+
+uint64_t WriteAheadLog::append(WalOp op, TKey key, const TVal &value) {
+  std::lock_guard guard(lock);
+  reserveRecord(WAL_RECORD_HEADER + value.size());
+  encodeRecord(pending, op, key, value);
+  return ++appendedLsn;
+}
+
+uint64_t WriteAheadLog::append(const WriteBatch &batch) {
+  size_t bytes = 0;
+  for (auto &op : batch.getOps())
+    bytes += WAL_RECORD_HEADER + op.value.size();
+  std::lock_guard guard(lock);
+  reserveRecord(bytes);
+  for (auto &op : batch.getOps())
+    encodeRecord(pending, op.op, op.key, op.value);
+  appendedLsn += batch.size();
+  return appendedLsn;
+}
+
+void WriteAheadLog::sync(uint64_t lsn) {
+  std::unique_lock guard(lock);
+  while (durableLsn < lsn) {
+    if (failure)
+      throw std::system_error(failure, std::generic_category(), "wal " + path);
+    if (flushing) {
+      flushed.wait(guard);
+      continue;
+    }
+    flushing = true;
+    std::string batch;
+    std::vector<size_t> starts;
+    batch.swap(pending);
+    starts.swap(batchStarts);
+    resetPending();
+    uint64_t batchLsn = appendedLsn;
+    guard.unlock();
+
+    for (size_t k = 0; k < starts.size(); k++) {
+      size_t end = k + 1 < starts.size() ? starts[k + 1] : batch.size();
+      WalBatchHeader header{
+          WAL_MAGIC,
+          static_cast<uint32_t>(end - starts[k] - sizeof(header)), 0};
+      header.checksum =
+          checksum(batch.data() + starts[k] + sizeof(header), header.bytes);
+      std::memcpy(batch.data() + starts[k], &header, sizeof(header));
+    }
+    int error = 0;
+    try {
+      writeAll(fd, batch.data(), batch.size(), path);
+      if (fdatasync(fd) < 0)
+        error = errno;
+    } catch (const std::system_error &e) {
+      error = e.code().value();
+    }
+
+    guard.lock();
+    flushing = false;
+    flushed.notify_all();
+    if (error) {
+      failure = error;
+      throw std::system_error(error, std::generic_category(),
+                              "fdatasync " + path);
+    }
+    durableLsn = batchLsn;
+    logBytes += batch.size();
+  }
+}
+
+void WriteAheadLog::sync() { sync(getAppendedLsn()); }
+
+void WriteAheadLog::waitIdle(std::unique_lock<std::mutex> &guard) {
+  while (flushing)
+    flushed.wait(guard);
+}
+
+void WriteAheadLog::truncate() {
+  std::unique_lock guard(lock);
+  waitIdle(guard);
+  resetPending();
+  if (ftruncate(fd, 0) < 0)
+    throw std::system_error(errno, std::generic_category(), "ftruncate " + path);
+  if (fdatasync(fd) < 0)
+    throw std::system_error(errno, std::generic_category(), "fdatasync " + path);
+  durableLsn = appendedLsn;
+  logBytes = 0;
+}
+
+uint64_t WriteAheadLog::getAppendedLsn() {
+  std::lock_guard guard(lock);
+  return appendedLsn;
+}
+
+uint64_t WriteAheadLog::getDurableLsn() {
+  std::lock_guard guard(lock);
+  return durableLsn;
+}
+
+uint64_t WriteAheadLog::getLogBytes() {
+  std::lock_guard guard(lock);
+  return logBytes;
+}
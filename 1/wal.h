@@ -0,0 +1,95 @@
+#pragma once
+
+#include "hashmap.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class WalOp : uint8_t { Set = 1, Remove = 2 };
+
+class WriteBatch;
+
+// Пачка записей, сбрасываемая одним write + fdatasync. Контрольная сумма
+// позволяет при восстановлении отбросить недописанный хвост лога
+struct WalBatchHeader {
+  uint32_t magic;
+  uint32_t bytes;
+  uint64_t checksum;
+};
+
+// Запись внутри пачки: op (1 байт) | key (4 байта) | length (4 байта) | value
+constexpr size_t WAL_RECORD_HEADER = 9;
+
+// Наибольшая длина пачки без заголовка (столько помещается в bytes)
+constexpr size_t WAL_MAX_BATCH = UINT32_MAX;
+
+// Append-only журнал операций set/remove с групповым коммитом.
+// append потокобезопасен и только кладёт запись в буфер; sync(lsn) ждёт,
+// пока запись не окажется на диске. Первый пришедший в sync поток
+// становится лидером и сбрасывает все накопленные записи одним
+// fdatasync, остальные ждут его результата
+class WriteAheadLog {
+private:
+  std::string path;
+  int fd;
+
+  std::mutex lock;
+  std::condition_variable flushed;
+  // Накопленные записи; пачка в заголовке хранит длину в uint32_t, поэтому
+  // pending режется на пачки не длиннее WAL_MAX_BATCH, и batchStarts -
+  // смещения их заголовков (первая всегда с нуля)
+  std::string pending;
+  std::vector<size_t> batchStarts;
+  uint64_t appendedLsn;
+  uint64_t durableLsn;
+  uint64_t logBytes;
+  bool flushing;
+  // Ошибка записи: часть пачки могла не попасть на диск, поэтому дальше
+  // журнал считается сломанным и sync всегда бросает исключение
+  int failure;
+
+  void resetPending();
+  void reserveRecord(size_t bytes);
+  void waitIdle(std::unique_lock<std::mutex> &guard);
+
+public:
+  explicit WriteAheadLog(const std::string &path);
+
+  ~WriteAheadLog();
+
+  WriteAheadLog(const WriteAheadLog &) = delete;
+  WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+  // Проигрывает лог в fn(op, key, value, length) и отрезает недописанный
+  // хвост; вызывать до первого append. Возвращает число записей
+  uint64_t replay(
+      const std::function<void(WalOp, TKey, const char *, uint32_t)> &fn);
+
+  // Возвращает порядковый номер записи (LSN). Запись длиннее WAL_MAX_BATCH -
+  // std::length_error
+  uint64_t append(WalOp op, TKey key, const TVal &value = TVal());
+
+  // Кладёт все записи пачки подряд под одной блокировкой: они попадут в
+  // одну сбрасываемую пачку и восстановятся либо все, либо ни одна.
+  // Возвращает LSN последней записи; если все записи вместе не помещаются
+  // в WAL_MAX_BATCH - std::length_error
+  uint64_t append(const WriteBatch &batch);
+
+  // Ждёт, пока все записи до lsn включительно не будут на диске
+  void sync(uint64_t lsn);
+
+  // Сбрасывает всё накопленное
+  void sync();
+
+  // Сбрасывает буфер и обрезает лог до нуля (после чекпоинта)
+  void truncate();
+
+  uint64_t getAppendedLsn();
+
+  uint64_t getDurableLsn();
+
+  uint64_t getLogBytes();
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "hashmap.h"
+#include "wal.h"
+#include <vector>
+
+struct WriteOp {
+  WalOp op;
+  TKey key;
+  TVal value;
+};
+
+// Набор изменений, который применяется к ConcurrentHashMap и пишется в WAL
+// как одно целое. Порядок операций над одним ключом сохраняется
+class WriteBatch {
+private:
+  std::vector<WriteOp> ops;
+
+public:
+  void put(TKey key, TVal value) {
+    ops.push_back(WriteOp{WalOp::Set, key, std::move(value)});
+  }
+
+  void remove(TKey key) { ops.push_back(WriteOp{WalOp::Remove, key, TVal()}); }
+
+  void clear() { ops.clear(); }
+
+  size_t size() const { return ops.size(); }
+
+  bool empty() const { return ops.empty(); }
+
+  const std::vector<WriteOp> &getOps() const { return ops; }
+};
@@ -1,9 +1,22 @@
+#include "channel_histogram.h"
+#include "clahe.h"
 #include "histogram.h"
+#include "image_file.h"
+#include "wide_histogram.h"
 #include <benchmark/benchmark.h>
 #include <vector>
 #include <random>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <numeric>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <utility>
 
 std::vector<uint8_t> generate_random_image(size_t size) {
     std::vector<uint8_t> data(size);
@@ -105,4 +118,481 @@ static void BM_Histogram_SIMD_Gradient(benchmark::State& state) {
 }
 BENCHMARK(BM_Histogram_SIMD_Gradient)->RangeMultiplier(4)->Range(1 << 12, 1 << 24);
 
+// Одно изображение 64 МБ: целиком через histogram_simd и кусками разного
+// размера через HistogramAccumulator
+constexpr size_t STREAM_IMAGE_SIZE = 64 << 20;
+
+static const std::vector<uint8_t>& stream_image() {
+    static const std::vector<uint8_t> data = generate_random_image(STREAM_IMAGE_SIZE);
+    return data;
+}
+
+static void BM_Histogram_OneShot(benchmark::State& state) {
+    const auto& data = stream_image();
+    Histogram hist;
+    
+    for (auto _ : state) {
+        histogram_simd(data.data(), data.size(), hist);
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(BM_Histogram_OneShot);
+
+static void BM_Histogram_Accumulator(benchmark::State& state) {
+    const auto& data = stream_image();
+    const size_t chunk = state.range(0);
+    HistogramAccumulator accumulator;
+    Histogram hist;
+    
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < data.size(); offset += chunk) {
+            accumulator.update(data.data() + offset, std::min(chunk, data.size() - offset));
+        }
+        accumulator.finalize(hist);
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(BM_Histogram_Accumulator)->RangeMultiplier(4)->Range(4 << 10, 64 << 20);
+
+// Куски некратные 16 байтам: каждый хвост переносится в следующий кусок
+static void BM_Histogram_Accumulator_Unaligned(benchmark::State& state) {
+    const auto& data = stream_image();
+    const size_t chunk = state.range(0) - 1;
+    HistogramAccumulator accumulator;
+    Histogram hist;
+    
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < data.size(); offset += chunk) {
+            accumulator.update(data.data() + offset, std::min(chunk, data.size() - offset));
+        }
+        accumulator.finalize(hist);
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(BM_Histogram_Accumulator_Unaligned)->RangeMultiplier(4)->Range(4 << 10, 64 << 20);
+
+// Файл PGM 64 МБ во временном каталоге. Горячий - страницы уже в page cache;
+// холодный - перед каждой итерацией они выбрасываются через
+// POSIX_FADV_DONTNEED (на tmpfs это не работает, и холодный прогон не
+// отличается от горячего). Базовая линия - read() всего файла в буфер и
+// histogram_simd по пикселям
+constexpr size_t FILE_IMAGE_WIDTH = 8192;
+constexpr size_t FILE_IMAGE_HEIGHT = 8192;
+
+static const std::string& pgm_file() {
+    static const std::string path = [] {
+        std::string path = (std::filesystem::temp_directory_path() / "histogram_bench.pgm").string();
+        std::string header = "P5\n" + std::to_string(FILE_IMAGE_WIDTH) + " " + std::to_string(FILE_IMAGE_HEIGHT) + "\n255\n";
+        auto pixels = generate_random_image(FILE_IMAGE_WIDTH * FILE_IMAGE_HEIGHT);
+        std::ofstream out(path, std::ios::binary);
+        out.write(header.data(), header.size());
+        out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+        return path;
+    }();
+    return path;
+}
+
+static void drop_page_cache(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static void histogram_file_read(const std::string& path, std::vector<uint8_t>& buffer, Histogram& hist) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    fstat(fd, &info);
+    buffer.resize(info.st_size);
+    size_t done = 0;
+    while (done < buffer.size()) {
+        ssize_t got = read(fd, buffer.data() + done, buffer.size() - done);
+        if (got <= 0) {
+            break;
+        }
+        done += got;
+    }
+    close(fd);
+    size_t pixels = FILE_IMAGE_WIDTH * FILE_IMAGE_HEIGHT;
+    histogram_simd(buffer.data() + buffer.size() - pixels, pixels, hist);
+}
+
+static void BM_File(benchmark::State& state, bool use_mmap, bool cold) {
+    const auto& path = pgm_file();
+    std::vector<uint8_t> buffer;
+    Histogram hist;
+    
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            drop_page_cache(path);
+            state.ResumeTiming();
+        }
+        if (use_mmap) {
+            histogram_file(path, hist);
+        } else {
+            histogram_file_read(path, buffer, hist);
+        }
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(FILE_IMAGE_WIDTH * FILE_IMAGE_HEIGHT));
+}
+BENCHMARK_CAPTURE(BM_File, Read_Hot, false, false)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_File, Mmap_Hot, true, false)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_File, Read_Cold, false, true)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_File, Mmap_Cold, true, true)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Изображение 4096 × 4096 с чередующимися каналами: один проход
+// histogram_interleaved против разборки в отдельные плоскости и
+// histogram_simd по каждой (и по плоскости яркости, если она нужна)
+constexpr size_t CHANNEL_IMAGE_PIXELS = 4096 * 4096;
+
+static void BM_Channels_Interleaved(benchmark::State& state, PixelLayout layout, bool with_luma) {
+    size_t size = CHANNEL_IMAGE_PIXELS * layout_group_bytes(layout) / (layout == PixelLayout::YUYV ? 2 : 1);
+    auto data = generate_random_image(size);
+    ChannelHistograms channels;
+    Histogram luma;
+    
+    for (auto _ : state) {
+        histogram_interleaved(data.data(), data.size(), layout, channels, with_luma ? &luma : nullptr);
+        benchmark::DoNotOptimize(channels);
+        benchmark::DoNotOptimize(luma);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+
+static void BM_Channels_Planar(benchmark::State& state, PixelLayout layout, bool with_luma) {
+    size_t size = CHANNEL_IMAGE_PIXELS * layout_group_bytes(layout) / (layout == PixelLayout::YUYV ? 2 : 1);
+    auto data = generate_random_image(size);
+    size_t group = layout_group_bytes(layout);
+    size_t groups = size / group;
+    std::vector<std::vector<uint8_t>> planes(group, std::vector<uint8_t>(groups));
+    std::vector<uint8_t> luma_plane(groups);
+    ChannelHistograms channels;
+    Histogram luma;
+    
+    for (auto _ : state) {
+        for (size_t i = 0; i < groups; ++i) {
+            for (size_t c = 0; c < group; ++c) {
+                planes[c][i] = data[i * group + c];
+            }
+        }
+        if (layout == PixelLayout::YUYV) {
+            // Y0 и Y1 - одна плоскость, считаются двумя вызовами и складываются
+            histogram_simd(planes[0].data(), groups, channels[0]);
+            histogram_simd(planes[2].data(), groups, luma);
+            for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+                channels[0][j] += luma[j];
+            }
+            histogram_simd(planes[1].data(), groups, channels[1]);
+            histogram_simd(planes[3].data(), groups, channels[2]);
+            luma = channels[0];
+        } else {
+            for (size_t c = 0; c < group; ++c) {
+                histogram_simd(planes[c].data(), groups, channels[c]);
+            }
+            if (with_luma) {
+                for (size_t i = 0; i < groups; ++i) {
+                    luma_plane[i] = (77 * planes[0][i] + 150 * planes[1][i] + 29 * planes[2][i] + 128) >> 8;
+                }
+                histogram_simd(luma_plane.data(), groups, luma);
+            }
+        }
+        benchmark::DoNotOptimize(channels);
+        benchmark::DoNotOptimize(luma);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK_CAPTURE(BM_Channels_Interleaved, RGB, PixelLayout::RGB, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Planar, RGB, PixelLayout::RGB, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Interleaved, RGB_Luma, PixelLayout::RGB, true)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Planar, RGB_Luma, PixelLayout::RGB, true)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Interleaved, RGBA, PixelLayout::RGBA, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Planar, RGBA, PixelLayout::RGBA, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Interleaved, RGBA_Luma, PixelLayout::RGBA, true)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Planar, RGBA_Luma, PixelLayout::RGBA, true)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Interleaved, YUYV, PixelLayout::YUYV, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Channels_Planar, YUYV, PixelLayout::YUYV, false)->Unit(benchmark::kMillisecond);
+
+// Кадр 4096 × 4096 со строками по 4160 байт; квадратная область со стороной
+// range(0) начинается с нечётного смещения, так что строки не выровнены.
+// histogram_2d по строкам на месте против копирования области в плотный
+// буфер и histogram_simd
+constexpr size_t ROI_FRAME_SIZE = 4096;
+constexpr size_t ROI_FRAME_STRIDE = ROI_FRAME_SIZE + 64;
+
+static HistogramRect roi_rect(size_t side) {
+    size_t offset = side < ROI_FRAME_SIZE ? 3 : 0;
+    return {offset, offset, side, side};
+}
+
+static void BM_ROI_Strided(benchmark::State& state) {
+    auto frame = generate_random_image(ROI_FRAME_STRIDE * ROI_FRAME_SIZE);
+    HistogramRect roi = roi_rect(state.range(0));
+    Histogram hist;
+    
+    for (auto _ : state) {
+        histogram_2d(frame.data(), ROI_FRAME_SIZE, ROI_FRAME_SIZE, ROI_FRAME_STRIDE, hist, &roi);
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(roi.width * roi.height));
+}
+BENCHMARK(BM_ROI_Strided)->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_ROI_Copy(benchmark::State& state) {
+    auto frame = generate_random_image(ROI_FRAME_STRIDE * ROI_FRAME_SIZE);
+    HistogramRect roi = roi_rect(state.range(0));
+    std::vector<uint8_t> packed(roi.width * roi.height);
+    Histogram hist;
+    
+    for (auto _ : state) {
+        for (size_t row = 0; row < roi.height; ++row) {
+            std::memcpy(packed.data() + row * roi.width,
+                        frame.data() + (roi.y + row) * ROI_FRAME_STRIDE + roi.x, roi.width);
+        }
+        histogram_simd(packed.data(), packed.size(), hist);
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(roi.width * roi.height));
+}
+BENCHMARK(BM_ROI_Copy)->RangeMultiplier(4)->Range(16, 4096);
+
+// Изображение 4096 × 4096 глубиной 10, 12 и 16 бит в uint16_t: одна таблица
+// на 2^Bits корзин против histogram_wide (несколько локальных таблиц) и
+// histogram_wide_parallel; 16 бит ещё и с прореживанием до 4096 корзин
+constexpr size_t WIDE_IMAGE_PIXELS = 4096 * 4096;
+
+enum class WideMethod {
+    Naive,
+    Tables,
+    Parallel,
+};
+
+static std::vector<uint16_t> generate_wide_image(unsigned bits, bool uniform) {
+    std::vector<uint16_t> data(WIDE_IMAGE_PIXELS, uint16_t(1u << (bits - 1)));
+    if (!uniform) {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<uint32_t> dist(0, (1u << bits) - 1);
+        for (auto& pixel : data) {
+            pixel = uint16_t(dist(gen));
+        }
+    }
+    return data;
+}
+
+template <unsigned Bits, size_t Bins>
+static void BM_Wide(benchmark::State& state, WideMethod method, bool uniform) {
+    auto data = generate_wide_image(Bits, uniform);
+    auto hist = std::make_unique<WideHistogram<Bins>>();
+    // Пул создаётся один раз, чтобы в замер не попадал запуск потоков
+    std::unique_ptr<ThreadPool> pool;
+    if (method == WideMethod::Parallel) {
+        pool = std::make_unique<ThreadPool>(state.range(0));
+    }
+    
+    for (auto _ : state) {
+        switch (method) {
+        case WideMethod::Naive:
+            histogram_wide_naive<Bits, Bins>(data.data(), data.size(), *hist);
+            break;
+        case WideMethod::Tables:
+            histogram_wide<Bits, Bins>(data.data(), data.size(), *hist);
+            break;
+        case WideMethod::Parallel:
+            histogram_wide_parallel<Bits, Bins>(data.data(), data.size(), *hist, *pool);
+            break;
+        }
+        benchmark::DoNotOptimize(*hist);
+    }
+    
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+
+template <unsigned Bits, size_t Bins>
+static void register_wide_benchmarks(const std::string& depth) {
+    const std::pair<const char*, WideMethod> methods[] = {
+        {"Naive", WideMethod::Naive},
+        {"Tables", WideMethod::Tables},
+        {"Parallel", WideMethod::Parallel},
+    };
+    for (auto [method_name, method] : methods) {
+        for (bool uniform : {false, true}) {
+            std::string name = "BM_Wide_" + depth + "_" + method_name + (uniform ? "_Uniform" : "_Random");
+            auto* bench = benchmark::RegisterBenchmark(name.c_str(), BM_Wide<Bits, Bins>, method, uniform)
+                              ->Unit(benchmark::kMillisecond)
+                              ->UseRealTime();
+            if (method == WideMethod::Parallel) {
+                bench->Arg(2)->Arg(4)->Arg(8);
+            }
+        }
+    }
+}
+
+static const bool wide_benchmarks_registered = [] {
+    register_wide_benchmarks<10, 1024>("10bit");
+    register_wide_benchmarks<12, 4096>("12bit");
+    register_wide_benchmarks<16, 65536>("16bit");
+    register_wide_benchmarks<16, 4096>("16bit_4096bins");
+    return true;
+}();
+
+// CLAHE на кадрах 1920 × 1080 и 3840 × 2160 с сеткой 8 × 8. Гистограммы всех
+// тайлов за один проход (вместе с обрезкой и LUT) против histogram_2d на
+// каждый тайл; интерполяция через пары LUT против покадрового расчёта с float
+static void BM_Clahe_Analyze(benchmark::State& state) {
+    size_t width = state.range(0), height = state.range(1);
+    auto frame = generate_random_image(width * height);
+    Clahe clahe(width, height);
+    
+    for (auto _ : state) {
+        clahe.analyze(frame.data(), width);
+        benchmark::DoNotOptimize(clahe.lut(0, 0));
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frame.size()));
+}
+BENCHMARK(BM_Clahe_Analyze)->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMillisecond);
+
+static void BM_Clahe_PerTileHistograms(benchmark::State& state) {
+    size_t width = state.range(0), height = state.range(1);
+    auto frame = generate_random_image(width * height);
+    constexpr size_t tiles = 8;
+    std::vector<Histogram> hists(tiles * tiles);
+    
+    for (auto _ : state) {
+        for (size_t ty = 0; ty < tiles; ++ty) {
+            for (size_t tx = 0; tx < tiles; ++tx) {
+                HistogramRect tile = {tx * width / tiles, ty * height / tiles,
+                                      (tx + 1) * width / tiles - tx * width / tiles,
+                                      (ty + 1) * height / tiles - ty * height / tiles};
+                histogram_2d(frame.data(), width, height, width, hists[ty * tiles + tx], &tile);
+            }
+        }
+        benchmark::DoNotOptimize(hists.data());
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frame.size()));
+}
+BENCHMARK(BM_Clahe_PerTileHistograms)->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMillisecond);
+
+static void BM_Clahe_Map(benchmark::State& state) {
+    size_t width = state.range(0), height = state.range(1);
+    auto frame = generate_random_image(width * height);
+    std::vector<uint8_t> out(frame.size());
+    Clahe clahe(width, height);
+    clahe.analyze(frame.data(), width);
+    
+    for (auto _ : state) {
+        clahe.map(frame.data(), width, out.data(), width);
+        benchmark::DoNotOptimize(out.data());
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frame.size()));
+}
+BENCHMARK(BM_Clahe_Map)->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMillisecond);
+
+static void BM_Clahe_MapNaive(benchmark::State& state) {
+    size_t width = state.range(0), height = state.range(1);
+    auto frame = generate_random_image(width * height);
+    std::vector<uint8_t> out(frame.size());
+    constexpr size_t tiles = 8;
+    Clahe clahe(width, height);
+    clahe.analyze(frame.data(), width);
+    
+    for (auto _ : state) {
+        for (size_t y = 0; y < height; ++y) {
+            float fy = (y + 0.5f) * tiles / height - 0.5f;
+            float y0 = std::floor(fy), ay = fy - y0;
+            size_t ty0 = size_t(std::clamp(y0, 0.0f, float(tiles - 1)));
+            size_t ty1 = size_t(std::clamp(y0 + 1, 0.0f, float(tiles - 1)));
+            for (size_t x = 0; x < width; ++x) {
+                float fx = (x + 0.5f) * tiles / width - 0.5f;
+                float x0 = std::floor(fx), ax = fx - x0;
+                size_t tx0 = size_t(std::clamp(x0, 0.0f, float(tiles - 1)));
+                size_t tx1 = size_t(std::clamp(x0 + 1, 0.0f, float(tiles - 1)));
+                uint8_t v = frame[y * width + x];
+                float top = clahe.lut(tx0, ty0)[v] * (1 - ax) + clahe.lut(tx1, ty0)[v] * ax;
+                float bottom = clahe.lut(tx0, ty1)[v] * (1 - ax) + clahe.lut(tx1, ty1)[v] * ax;
+                out[y * width + x] = uint8_t(top * (1 - ay) + bottom * ay + 0.5f);
+            }
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frame.size()));
+}
+BENCHMARK(BM_Clahe_MapNaive)->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMillisecond);
+
+static void BM_Clahe_Apply(benchmark::State& state) {
+    size_t width = state.range(0), height = state.range(1);
+    auto frame = generate_random_image(width * height);
+    std::vector<uint8_t> out(frame.size());
+    ClaheParams params;
+    params.num_threads = state.range(2);
+    Clahe clahe(width, height, params);
+    
+    for (auto _ : state) {
+        clahe.apply(frame.data(), width, out.data(), width);
+        benchmark::DoNotOptimize(out.data());
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frame.size()));
+}
+BENCHMARK(BM_Clahe_Apply)
+    ->Args({1920, 1080, 1})->Args({1920, 1080, 2})->Args({1920, 1080, 4})
+    ->Args({3840, 2160, 1})->Args({3840, 2160, 2})->Args({3840, 2160, 4})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Каждое доступное на этой машине ядро вызывается напрямую, в обход выбора
+// в histogram_simd, чтобы сравнить их на одних данных
+static void BM_Histogram_Kernel(benchmark::State& state, HistogramFunction kernel,
+                                std::vector<uint8_t> (*generate)(size_t)) {
+    auto data = generate(state.range(0));
+    Histogram hist;
+    
+    for (auto _ : state) {
+        kernel(data.data(), data.size(), hist);
+        benchmark::DoNotOptimize(hist);
+    }
+    
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(state.range(0)));
+}
+
+static std::vector<uint8_t> generate_uniform_128(size_t size) {
+    return generate_uniform_image(size, 128);
+}
+
+static const bool kernel_benchmarks_registered = [] {
+    const std::pair<const char*, std::vector<uint8_t> (*)(size_t)> datasets[] = {
+        {"Random", generate_random_image},
+        {"Uniform", generate_uniform_128},
+        {"Gradient", generate_gradient_image},
+    };
+    for (HistogramKernel kernel : HISTOGRAM_KERNELS) {
+        HistogramFunction function = histogram_kernel(kernel);
+        if (!function) {
+            continue;
+        }
+        for (auto [dataset, generate] : datasets) {
+            std::string name = std::string("BM_Histogram_Kernel_") + histogram_kernel_name(kernel) + "_" + dataset;
+            benchmark::RegisterBenchmark(name.c_str(), BM_Histogram_Kernel, function, generate)
+                ->RangeMultiplier(4)
+                ->Range(1 << 12, 1 << 24);
+        }
+    }
+    return true;
+}();
+
 BENCHMARK_MAIN();
@@ -0,0 +1,379 @@
+#include "channel_histogram.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define HAS_X86_KERNELS 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define HAS_NEON_KERNEL 1
+#endif
+
+template <PixelLayout Layout>
+struct LayoutTraits;
+
+template <>
+struct LayoutTraits<PixelLayout::RGB> {
+    static constexpr size_t group = 3;
+    static constexpr size_t channels = 3;
+    static constexpr uint8_t channel_of[group] = {0, 1, 2};
+};
+
+template <>
+struct LayoutTraits<PixelLayout::RGBA> {
+    static constexpr size_t group = 4;
+    static constexpr size_t channels = 4;
+    static constexpr uint8_t channel_of[group] = {0, 1, 2, 3};
+};
+
+template <>
+struct LayoutTraits<PixelLayout::YUYV> {
+    static constexpr size_t group = 4;
+    static constexpr size_t channels = 3;
+    static constexpr uint8_t channel_of[group] = {0, 1, 0, 2};
+};
+
+size_t layout_channels(PixelLayout layout) {
+    switch (layout) {
+    case PixelLayout::RGB: return LayoutTraits<PixelLayout::RGB>::channels;
+    case PixelLayout::RGBA: return LayoutTraits<PixelLayout::RGBA>::channels;
+    case PixelLayout::YUYV: return LayoutTraits<PixelLayout::YUYV>::channels;
+    }
+    return 0;
+}
+
+size_t layout_group_bytes(PixelLayout layout) {
+    switch (layout) {
+    case PixelLayout::RGB: return LayoutTraits<PixelLayout::RGB>::group;
+    case PixelLayout::RGBA: return LayoutTraits<PixelLayout::RGBA>::group;
+    case PixelLayout::YUYV: return LayoutTraits<PixelLayout::YUYV>::group;
+    }
+    return 0;
+}
+
+// Как в ядре Compact: байты берутся 64-битными словами, у каждого канала
+// CHANNEL_TABLES таблиц uint16_t. Блок - наименьшее число байт, кратное 8 и
+// содержащее каждый канал хотя бы CHANNEL_TABLES раз, поэтому канал и
+// таблица каждого байта блока известны при компиляции
+constexpr size_t CHANNEL_TABLES = 4;
+
+using ChannelCounters = uint16_t[MAX_CHANNELS][CHANNEL_TABLES][HISTOGRAM_SIZE];
+
+template <PixelLayout Layout>
+struct CountPlan {
+    static constexpr size_t bytes = std::lcm(LayoutTraits<Layout>::group * CHANNEL_TABLES, size_t(8));
+    uint8_t channel[bytes] = {};
+    uint8_t table[bytes] = {};
+    size_t max_per_table = 0;
+};
+
+template <PixelLayout Layout>
+constexpr CountPlan<Layout> make_plan() {
+    using Traits = LayoutTraits<Layout>;
+    CountPlan<Layout> plan;
+    size_t seen[MAX_CHANNELS] = {};
+    for (size_t p = 0; p < plan.bytes; ++p) {
+        size_t channel = Traits::channel_of[p % Traits::group];
+        plan.channel[p] = channel;
+        plan.table[p] = seen[channel] % CHANNEL_TABLES;
+        ++seen[channel];
+    }
+    for (size_t c = 0; c < Traits::channels; ++c) {
+        plan.max_per_table = std::max(plan.max_per_table, (seen[c] + CHANNEL_TABLES - 1) / CHANNEL_TABLES);
+    }
+    return plan;
+}
+
+// Между сливами в таблицу попадает не больше max_per_table на блок плюс
+// хвост неполного блока (меньше 8 групп) в конце буфера
+template <PixelLayout Layout>
+constexpr size_t spill_blocks() {
+    return (65535 - 8) / make_plan<Layout>().max_per_table;
+}
+
+template <PixelLayout Layout>
+static void count_channels(ChannelCounters& counters, const uint8_t* data, size_t blocks) {
+    static constexpr CountPlan<Layout> plan = make_plan<Layout>();
+    for (size_t b = 0; b < blocks; ++b, data += plan.bytes) {
+        for (size_t w = 0; w < plan.bytes; w += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + w, sizeof(word));
+            for (size_t k = 0; k < 8; ++k) {
+                ++counters[plan.channel[w + k]][plan.table[w + k]][word & 0xff];
+                word >>= 8;
+            }
+        }
+    }
+}
+
+template <PixelLayout Layout>
+static void spill_channels(ChannelCounters& counters, ChannelHistograms& channels) {
+    for (size_t c = 0; c < LayoutTraits<Layout>::channels; ++c) {
+        for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+            uint32_t total = 0;
+            for (size_t k = 0; k < CHANNEL_TABLES; ++k) {
+                total += counters[c][k][j];
+            }
+            channels[c][j] += total;
+        }
+    }
+    std::memset(counters, 0, sizeof(ChannelCounters));
+}
+
+static void rgb_to_luma_scalar(const uint8_t* data, size_t count, size_t group, uint8_t* dst) {
+    for (size_t i = 0; i < count; ++i, data += group) {
+        dst[i] = (77 * data[0] + 150 * data[1] + 29 * data[2] + 128) >> 8;
+    }
+}
+
+#if defined(HAS_X86_KERNELS)
+
+// Маска PSHUFB, собирающая из загрузки load (16 байт) байты канала channel
+// для 16 пикселей по group байт; чужие позиции (0x80) обнуляются
+struct ShuffleMasks {
+    alignas(16) uint8_t mask[3][4][16];
+};
+
+static constexpr ShuffleMasks make_shuffle_masks(size_t group) {
+    ShuffleMasks masks = {};
+    for (size_t channel = 0; channel < 3; ++channel) {
+        for (size_t load = 0; load < group; ++load) {
+            for (size_t out = 0; out < 16; ++out) {
+                size_t pos = out * group + channel;
+                masks.mask[channel][load][out] = pos / 16 == load ? pos % 16 : 0x80;
+            }
+        }
+    }
+    return masks;
+}
+
+static constexpr ShuffleMasks RGB_MASKS = make_shuffle_masks(3);
+static constexpr ShuffleMasks RGBA_MASKS = make_shuffle_masks(4);
+
+template <size_t Group>
+__attribute__((target("sse4.1")))
+static inline __m128i gather_channel(const __m128i (&loads)[Group], const ShuffleMasks& masks, size_t channel) {
+    __m128i result = _mm_setzero_si128();
+    for (size_t load = 0; load < Group; ++load) {
+        __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(masks.mask[channel][load]));
+        result = _mm_or_si128(result, _mm_shuffle_epi8(loads[load], mask));
+    }
+    return result;
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i luma_epi16(__m128i r, __m128i g, __m128i b) {
+    // 77 * 255 + 150 * 255 + 29 * 255 + 128 < 65536: беззнаковые 16 бит не переполняются
+    __m128i sum = _mm_mullo_epi16(r, _mm_set1_epi16(77));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+    return _mm_srli_epi16(sum, 8);
+}
+
+template <size_t Group>
+__attribute__((target("sse4.1")))
+static void rgb_to_luma_sse41(const uint8_t* data, size_t count, uint8_t* dst) {
+    const ShuffleMasks& masks = Group == 3 ? RGB_MASKS : RGBA_MASKS;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, data += 16 * Group) {
+        __m128i loads[Group];
+        for (size_t load = 0; load < Group; ++load) {
+            loads[load] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * load));
+        }
+        __m128i r = gather_channel<Group>(loads, masks, 0);
+        __m128i g = gather_channel<Group>(loads, masks, 1);
+        __m128i b = gather_channel<Group>(loads, masks, 2);
+
+        __m128i low = luma_epi16(_mm_cvtepu8_epi16(r), _mm_cvtepu8_epi16(g), _mm_cvtepu8_epi16(b));
+        __m128i high = luma_epi16(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+    }
+    rgb_to_luma_scalar(data, count - i, Group, dst + i);
+}
+
+// Те же 128-битные PSHUFB на два блока по 16 пикселей (PSHUFB в AVX2 не
+// переходит границу половин, а маски по 48/64 байт через неё перекрестились
+// бы), но расширение, умножения и упаковка идут по 32 пикселя: unpack и
+// packus работают внутри половин, поэтому порядок пикселей сохраняется сам
+template <size_t Group>
+__attribute__((target("avx2")))
+static inline __m256i gather_channel_avx2(const __m128i (&first)[Group], const __m128i (&second)[Group],
+                                          const ShuffleMasks& masks, size_t channel) {
+    __m256i result = _mm256_setzero_si256();
+    for (size_t load = 0; load < Group; ++load) {
+        __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(masks.mask[channel][load]));
+        __m256i pair = _mm256_inserti128_si256(_mm256_castsi128_si256(first[load]), second[load], 1);
+        result = _mm256_or_si256(result, _mm256_shuffle_epi8(pair, _mm256_broadcastsi128_si256(mask)));
+    }
+    return result;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i luma_epi16_avx2(__m256i r, __m256i g, __m256i b) {
+    __m256i sum = _mm256_mullo_epi16(r, _mm256_set1_epi16(77));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(g, _mm256_set1_epi16(150)));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(29)));
+    sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(sum, 8);
+}
+
+template <size_t Group>
+__attribute__((target("avx2")))
+static void rgb_to_luma_avx2(const uint8_t* data, size_t count, uint8_t* dst) {
+    const ShuffleMasks& masks = Group == 3 ? RGB_MASKS : RGBA_MASKS;
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32, data += 32 * Group) {
+        __m128i first[Group], second[Group];
+        for (size_t load = 0; load < Group; ++load) {
+            first[load] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * load));
+            second[load] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * (Group + load)));
+        }
+        __m256i r = gather_channel_avx2<Group>(first, second, masks, 0);
+        __m256i g = gather_channel_avx2<Group>(first, second, masks, 1);
+        __m256i b = gather_channel_avx2<Group>(first, second, masks, 2);
+
+        __m256i low = luma_epi16_avx2(_mm256_unpacklo_epi8(r, zero), _mm256_unpacklo_epi8(g, zero),
+                                      _mm256_unpacklo_epi8(b, zero));
+        __m256i high = luma_epi16_avx2(_mm256_unpackhi_epi8(r, zero), _mm256_unpackhi_epi8(g, zero),
+                                       _mm256_unpackhi_epi8(b, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(low, high));
+    }
+    rgb_to_luma_scalar(data, count - i, Group, dst + i);
+}
+
+#endif
+
+#if defined(HAS_NEON_KERNEL)
+
+static inline uint8x16_t luma_neon(uint8x16_t r, uint8x16_t g, uint8x16_t b) {
+    uint16x8_t low = vmull_u8(vget_low_u8(r), vdup_n_u8(77));
+    low = vmlal_u8(low, vget_low_u8(g), vdup_n_u8(150));
+    low = vmlal_u8(low, vget_low_u8(b), vdup_n_u8(29));
+    uint16x8_t high = vmull_u8(vget_high_u8(r), vdup_n_u8(77));
+    high = vmlal_u8(high, vget_high_u8(g), vdup_n_u8(150));
+    high = vmlal_u8(high, vget_high_u8(b), vdup_n_u8(29));
+    // vrshrn: (x + 128) >> 8 без переполнения промежуточной суммы
+    return vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8));
+}
+
+static void rgb_to_luma_neon(const uint8_t* data, size_t count, size_t group, uint8_t* dst) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, data += 16 * group) {
+        uint8x16_t luma;
+        if (group == 3) {
+            uint8x16x3_t pixels = vld3q_u8(data);
+            luma = luma_neon(pixels.val[0], pixels.val[1], pixels.val[2]);
+        } else {
+            uint8x16x4_t pixels = vld4q_u8(data);
+            luma = luma_neon(pixels.val[0], pixels.val[1], pixels.val[2]);
+        }
+        vst1q_u8(dst + i, luma);
+    }
+    rgb_to_luma_scalar(data, count - i, group, dst + i);
+}
+
+#endif
+
+void rgb_to_luma(const uint8_t* data, size_t count, PixelLayout layout, uint8_t* dst) {
+    if (layout == PixelLayout::YUYV) {
+        throw std::invalid_argument("rgb_to_luma: YUYV already carries luma in its Y channel");
+    }
+    size_t group = layout == PixelLayout::RGBA ? 4 : 3;
+#if defined(HAS_X86_KERNELS)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    static const bool has_sse41 = __builtin_cpu_supports("sse4.1");
+    if (has_avx2) {
+        if (group == 3) {
+            rgb_to_luma_avx2<3>(data, count, dst);
+        } else {
+            rgb_to_luma_avx2<4>(data, count, dst);
+        }
+        return;
+    }
+    if (has_sse41) {
+        if (group == 3) {
+            rgb_to_luma_sse41<3>(data, count, dst);
+        } else {
+            rgb_to_luma_sse41<4>(data, count, dst);
+        }
+        return;
+    }
+#elif defined(HAS_NEON_KERNEL)
+    rgb_to_luma_neon(data, count, group, dst);
+    return;
+#endif
+    rgb_to_luma_scalar(data, count, group, dst);
+}
+
+// Буфер обходится кусками по LUMA_CHUNK_PIXELS пикселей: пока кусок лежит в
+// L1/L2, по нему считаются и каналы, и яркость
+constexpr size_t LUMA_CHUNK_PIXELS = 4096;
+
+template <PixelLayout Layout>
+static void histogram_layout(const uint8_t* data, size_t size, ChannelHistograms& channels, Histogram* luma) {
+    using Traits = LayoutTraits<Layout>;
+    static constexpr CountPlan<Layout> plan = make_plan<Layout>();
+    constexpr size_t chunk_bytes = LUMA_CHUNK_PIXELS * Traits::group;
+    static_assert(chunk_bytes % plan.bytes == 0);
+    static_assert(chunk_bytes / plan.bytes <= spill_blocks<Layout>());
+
+    alignas(64) ChannelCounters counters = {};
+    alignas(64) uint8_t luma_buffer[LUMA_CHUNK_PIXELS];
+    const bool luma_from_rgb = luma && Layout != PixelLayout::YUYV;
+    HistogramAccumulator accumulator;
+
+    for (auto& hist : channels) {
+        hist.fill(0);
+    }
+
+    const size_t whole = size - size % Traits::group;
+    size_t since_spill = 0;
+    for (size_t offset = 0; offset < whole; offset += chunk_bytes) {
+        const uint8_t* chunk = data + offset;
+        size_t bytes = std::min(chunk_bytes, whole - offset);
+        size_t blocks = bytes / plan.bytes;
+        if (since_spill + blocks > spill_blocks<Layout>()) {
+            spill_channels<Layout>(counters, channels);
+            since_spill = 0;
+        }
+        count_channels<Layout>(counters, chunk, blocks);
+        since_spill += blocks;
+        for (size_t i = blocks * plan.bytes; i < bytes; ++i) {
+            ++counters[Traits::channel_of[i % Traits::group]][0][chunk[i]];
+        }
+
+        if (luma_from_rgb) {
+            size_t pixels = bytes / Traits::group;
+            rgb_to_luma(chunk, pixels, Layout, luma_buffer);
+            accumulator.update(luma_buffer, pixels);
+        }
+    }
+    spill_channels<Layout>(counters, channels);
+
+    if (luma_from_rgb) {
+        accumulator.finalize(*luma);
+    } else if (luma) {
+        *luma = channels[0];
+    }
+}
+
+void histogram_interleaved(const uint8_t* data, size_t size, PixelLayout layout,
+                           ChannelHistograms& channels, Histogram* luma) {
+    switch (layout) {
+    case PixelLayout::RGB:
+        histogram_layout<PixelLayout::RGB>(data, size, channels, luma);
+        break;
+    case PixelLayout::RGBA:
+        histogram_layout<PixelLayout::RGBA>(data, size, channels, luma);
+        break;
+    case PixelLayout::YUYV:
+        histogram_layout<PixelLayout::YUYV>(data, size, channels, luma);
+        break;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "histogram.h"
+
+// Раскладка чередующихся каналов: RGB и RGBA по байту на канал, YUYV
+// (YUV 4:2:2) - Y0 U Y1 V на два пикселя, каналы Y, U, V
+enum class PixelLayout {
+    RGB,
+    RGBA,
+    YUYV,
+};
+
+constexpr size_t MAX_CHANNELS = 4;
+
+using ChannelHistograms = std::array<Histogram, MAX_CHANNELS>;
+
+size_t layout_channels(PixelLayout layout);
+
+// Байт на группу каналов: 3 для RGB, 4 для RGBA и YUYV (два пикселя)
+size_t layout_group_bytes(PixelLayout layout);
+
+// Гистограммы всех каналов за один проход по чередующемуся буферу; неполная
+// группа в конце не считается, лишние каналы обнуляются. Если luma не
+// nullptr, туда же считается яркость: Y = (77 R + 150 G + 29 B + 128) >> 8
+// (BT.601) для RGB/RGBA и канал Y для YUYV
+void histogram_interleaved(const uint8_t* data, size_t size, PixelLayout layout,
+                           ChannelHistograms& channels, Histogram* luma = nullptr);
+
+// Яркость count пикселей RGB/RGBA в dst; каналы раскладываются в регистрах.
+// Для YUYV - std::invalid_argument: яркость там уже лежит в канале Y
+void rgb_to_luma(const uint8_t* data, size_t count, PixelLayout layout, uint8_t* dst);
@@ -0,0 +1,281 @@
+#include "clahe.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // SSE2 входит в базовый x86-64, target-атрибуты не нужны
+    #include <emmintrin.h>
+    #define HAS_SSE2_MAP 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define HAS_NEON_MAP 1
+#endif
+
+// Локальные таблицы на тайл: четыре по 1 КиБ, на строку из 8 тайлов - 32 КиБ,
+// то есть вся строка тайлов считается в L1
+constexpr size_t CLAHE_TABLES = 4;
+
+// Веса интерполяции в 7 битах: a * (128 - w) + b * w помещается в int16, а
+// второй шаг по вертикали - в int32, что даёт два _mm_madd_epi16 на пиксель
+constexpr unsigned CLAHE_WEIGHT_BITS = 7;
+constexpr uint32_t CLAHE_WEIGHT_ONE = 1u << CLAHE_WEIGHT_BITS;
+
+static void count_segment(uint32_t* tables, const uint8_t* data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        for (size_t k = 0; k < 8; ++k) {
+            ++tables[(k % CLAHE_TABLES) * HISTOGRAM_SIZE + (word & 0xff)];
+            word >>= 8;
+        }
+    }
+    for (; i < size; ++i) {
+        ++tables[data[i]];
+    }
+}
+
+// Обрезка как в OpenCV: излишек над порогом делится поровну между всеми
+// корзинами, остаток - по одному через равные промежутки
+static void build_lut(Histogram hist, size_t pixels, double clip_limit, HistogramLut& lut) {
+    if (clip_limit > 0) {
+        uint32_t limit = std::max<uint32_t>(1, uint32_t(clip_limit * pixels / HISTOGRAM_SIZE));
+        uint32_t excess = 0;
+        for (auto& count : hist) {
+            if (count > limit) {
+                excess += count - limit;
+                count = limit;
+            }
+        }
+        uint32_t batch = excess / HISTOGRAM_SIZE;
+        uint32_t residual = excess % HISTOGRAM_SIZE;
+        for (auto& count : hist) {
+            count += batch;
+        }
+        if (residual > 0) {
+            size_t step = std::max<size_t>(HISTOGRAM_SIZE / residual, 1);
+            for (size_t j = 0; j < HISTOGRAM_SIZE && residual > 0; j += step, --residual) {
+                ++hist[j];
+            }
+        }
+    }
+
+    uint64_t sum = 0;
+    for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+        sum += hist[j];
+        lut[j] = uint8_t((sum * 255 + pixels / 2) / pixels);
+    }
+}
+
+// top и bottom - пары (LUT левого тайла, LUT правого) в младших и старших 16
+// битах, column_weight - пары (128 - wx, wx), row_weight - (128 - wy, wy)
+static void map_row(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* top,
+                    const uint32_t* bottom, const uint32_t* column_offset,
+                    const uint32_t* column_weight, uint32_t row_weight) {
+    constexpr unsigned shift = 2 * CLAHE_WEIGHT_BITS;
+    size_t x = 0;
+
+#if defined(HAS_SSE2_MAP)
+    const __m128i wy = _mm_set1_epi32(int(row_weight));
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    auto blend4 = [&](size_t i) {
+        const uint32_t o0 = column_offset[i] + src[i];
+        const uint32_t o1 = column_offset[i + 1] + src[i + 1];
+        const uint32_t o2 = column_offset[i + 2] + src[i + 2];
+        const uint32_t o3 = column_offset[i + 3] + src[i + 3];
+        __m128i t = _mm_setr_epi32(int(top[o0]), int(top[o1]), int(top[o2]), int(top[o3]));
+        __m128i b = _mm_setr_epi32(int(bottom[o0]), int(bottom[o1]), int(bottom[o2]), int(bottom[o3]));
+        __m128i wx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column_weight + i));
+        t = _mm_madd_epi16(t, wx);
+        b = _mm_madd_epi16(b, wx);
+        __m128i r = _mm_madd_epi16(_mm_or_si128(t, _mm_slli_epi32(b, 16)), wy);
+        return _mm_srli_epi32(_mm_add_epi32(r, round), shift);
+    };
+    for (; x + 8 <= width; x += 8) {
+        __m128i r = _mm_packs_epi32(blend4(x), blend4(x + 4));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(r, r));
+    }
+#elif defined(HAS_NEON_MAP)
+    const uint16_t wy_top = uint16_t(row_weight & 0xffff);
+    const uint16_t wy_bottom = uint16_t(row_weight >> 16);
+    auto blend4 = [&](size_t i) {
+        uint32_t t[4], b[4];
+        for (size_t k = 0; k < 4; ++k) {
+            const uint32_t o = column_offset[i + k] + src[i + k];
+            t[k] = top[o];
+            b[k] = bottom[o];
+        }
+        uint16x8_t wx = vreinterpretq_u16_u32(vld1q_u32(column_weight + i));
+        uint16x8_t tp = vmulq_u16(vreinterpretq_u16_u32(vld1q_u32(t)), wx);
+        uint16x8_t bp = vmulq_u16(vreinterpretq_u16_u32(vld1q_u32(b)), wx);
+        uint16x8_t tb = vpaddq_u16(tp, bp);
+        uint32x4_t r = vmull_n_u16(vget_low_u16(tb), wy_top);
+        r = vmlal_n_u16(r, vget_high_u16(tb), wy_bottom);
+        return vrshrn_n_u32(r, shift);
+    };
+    for (; x + 8 <= width; x += 8) {
+        vst1_u8(dst + x, vmovn_u16(vcombine_u16(blend4(x), blend4(x + 4))));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        const uint32_t o = column_offset[x] + src[x];
+        const uint32_t wx_left = column_weight[x] & 0xffff, wx_right = column_weight[x] >> 16;
+        const uint32_t t = (top[o] & 0xffff) * wx_left + (top[o] >> 16) * wx_right;
+        const uint32_t b = (bottom[o] & 0xffff) * wx_left + (bottom[o] >> 16) * wx_right;
+        dst[x] = uint8_t((t * (row_weight & 0xffff) + b * (row_weight >> 16) + (1u << (shift - 1))) >> shift);
+    }
+}
+
+// Центр тайла i - середина [i * w / n, (i + 1) * w / n); для пикселя p
+// возвращает номер промежутка между центрами (0..n, крайние - до первого и
+// после последнего центра) и вес правого тайла
+static std::pair<size_t, uint32_t> interpolation(size_t p, size_t size, size_t tiles) {
+    double position = (p + 0.5) * tiles / size - 0.5;
+    double left = std::floor(position);
+    size_t segment = size_t(std::clamp(left + 1, 0.0, double(tiles)));
+    uint32_t weight = uint32_t(std::lround((position - left) * CLAHE_WEIGHT_ONE));
+    return {segment, weight};
+}
+
+Clahe::Clahe(size_t width, size_t height, const ClaheParams& params)
+    : width_(width), height_(height), params_(params) {
+    if (params.tiles_x == 0 || params.tiles_y == 0 || width < params.tiles_x || height < params.tiles_y) {
+        throw std::invalid_argument("Clahe: frame is smaller than the tile grid");
+    }
+    const size_t tiles_x = params.tiles_x, tiles_y = params.tiles_y;
+
+    for (size_t i = 0; i <= tiles_x; ++i) {
+        tile_x_.push_back(i * width / tiles_x);
+    }
+    for (size_t i = 0; i <= tiles_y; ++i) {
+        tile_y_.push_back(i * height / tiles_y);
+    }
+    hists_.resize(tiles_x * tiles_y);
+    luts_.resize(tiles_x * tiles_y);
+    tables_.resize(tiles_x * tiles_y * CLAHE_TABLES * HISTOGRAM_SIZE);
+    pairs_.resize(tiles_y * (tiles_x + 1) * HISTOGRAM_SIZE);
+
+    for (size_t x = 0; x < width; ++x) {
+        auto [segment, weight] = interpolation(x, width, tiles_x);
+        column_offset_.push_back(uint32_t(segment * HISTOGRAM_SIZE));
+        column_weight_.push_back((CLAHE_WEIGHT_ONE - weight) | (weight << 16));
+    }
+    for (size_t y = 0; y < height; ++y) {
+        auto [segment, weight] = interpolation(y, height, tiles_y);
+        size_t top = segment > 0 ? segment - 1 : 0;
+        size_t bottom = std::min(segment, tiles_y - 1);
+        rows_.push_back({top * (tiles_x + 1) * HISTOGRAM_SIZE, bottom * (tiles_x + 1) * HISTOGRAM_SIZE,
+                         (CLAHE_WEIGHT_ONE - weight) | (weight << 16)});
+    }
+
+    if (params.num_threads > 1) {
+        pool_ = std::make_unique<ThreadPool>(params.num_threads);
+    }
+}
+
+Clahe::~Clahe() = default;
+
+void Clahe::apply(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride) {
+    analyze(src, src_stride);
+    map(src, src_stride, dst, dst_stride);
+}
+
+void Clahe::analyze(const uint8_t* src, size_t stride) {
+    for_ranges(params_.tiles_y, [&](size_t begin, size_t end) {
+        for (size_t ty = begin; ty < end; ++ty) {
+            analyze_band(src, stride, ty);
+        }
+    });
+}
+
+void Clahe::map(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride) {
+    for_ranges(height_, [&](size_t begin, size_t end) {
+        map_rows(src, src_stride, dst, dst_stride, begin, end);
+    });
+}
+
+const Histogram& Clahe::histogram(size_t tx, size_t ty) const {
+    return hists_[ty * params_.tiles_x + tx];
+}
+
+const HistogramLut& Clahe::lut(size_t tx, size_t ty) const {
+    return luts_[ty * params_.tiles_x + tx];
+}
+
+// Строки полосы читаются по порядку, каждая режется на отрезки тайлов; так
+// кадр проходится один раз, а не тайл за тайлом со скачками через stride
+void Clahe::analyze_band(const uint8_t* src, size_t stride, size_t ty) {
+    const size_t tiles_x = params_.tiles_x;
+    constexpr size_t tile_tables = CLAHE_TABLES * HISTOGRAM_SIZE;
+    uint32_t* tables = tables_.data() + ty * tiles_x * tile_tables;
+    std::memset(tables, 0, tiles_x * tile_tables * sizeof(uint32_t));
+
+    for (size_t y = tile_y_[ty]; y < tile_y_[ty + 1]; ++y) {
+        const uint8_t* row = src + y * stride;
+        for (size_t tx = 0; tx < tiles_x; ++tx) {
+            count_segment(tables + tx * tile_tables, row + tile_x_[tx], tile_x_[tx + 1] - tile_x_[tx]);
+        }
+    }
+
+    const size_t rows = tile_y_[ty + 1] - tile_y_[ty];
+    for (size_t tx = 0; tx < tiles_x; ++tx) {
+        Histogram& hist = hists_[ty * tiles_x + tx];
+        const uint32_t* tile = tables + tx * tile_tables;
+        for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+            uint32_t total = 0;
+            for (size_t k = 0; k < CLAHE_TABLES; ++k) {
+                total += tile[k * HISTOGRAM_SIZE + j];
+            }
+            hist[j] = total;
+        }
+        build_lut(hist, rows * (tile_x_[tx + 1] - tile_x_[tx]), params_.clip_limit, luts_[ty * tiles_x + tx]);
+    }
+
+    uint32_t* pairs = pairs_.data() + ty * (tiles_x + 1) * HISTOGRAM_SIZE;
+    for (size_t segment = 0; segment <= tiles_x; ++segment) {
+        const HistogramLut& left = lut(segment > 0 ? segment - 1 : 0, ty);
+        const HistogramLut& right = lut(std::min(segment, tiles_x - 1), ty);
+        for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+            pairs[segment * HISTOGRAM_SIZE + j] = left[j] | (uint32_t(right[j]) << 16);
+        }
+    }
+}
+
+void Clahe::map_rows(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                     size_t begin, size_t end) const {
+    for (size_t y = begin; y < end; ++y) {
+        const RowInterpolation& row = rows_[y];
+        map_row(src + y * src_stride, dst + y * dst_stride, width_, pairs_.data() + row.top,
+                pairs_.data() + row.bottom, column_offset_.data(), column_weight_.data(), row.weight);
+    }
+}
+
+void Clahe::for_ranges(size_t count, const std::function<void(size_t begin, size_t end)>& fn) {
+    if (!pool_) {
+        fn(0, count);
+        return;
+    }
+
+    size_t parts = std::min(params_.num_threads, count);
+    std::vector<std::future<void>> futures;
+    futures.reserve(parts);
+    for (size_t part = 0; part < parts; ++part) {
+        size_t begin = count * part / parts;
+        size_t end = count * (part + 1) / parts;
+        futures.push_back(pool_->submit([&fn, begin, end]() {
+            fn(begin, end);
+        }));
+    }
+
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
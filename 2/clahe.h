@@ -0,0 +1,74 @@
+#pragma once
+
+#include "histogram.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+struct ClaheParams {
+    size_t tiles_x = 8;
+    size_t tiles_y = 8;
+    // Порог корзины в долях среднего числа пикселей на корзину тайла, как
+    // clipLimit в OpenCV; 0 - без обрезки (обычная адаптивная эквализация)
+    double clip_limit = 2.0;
+    // Больше 1 - строки тайлов и строки результата делятся между потоками
+    // ThreadPool из ЛР 3, который создаётся один раз вместе с объектом
+    size_t num_threads = 1;
+};
+
+using HistogramLut = std::array<uint8_t, HISTOGRAM_SIZE>;
+
+// CLAHE для потока кадров одного размера. Границы тайлов, веса интерполяции
+// и рабочие буферы считаются в конструкторе и переиспользуются; кадров
+// меньше сетки тайлов и пустой сетки не бывает (std::invalid_argument)
+class Clahe {
+public:
+    Clahe(size_t width, size_t height, const ClaheParams& params = {});
+    ~Clahe();
+
+    Clahe(const Clahe&) = delete;
+    Clahe& operator=(const Clahe&) = delete;
+
+    // analyze, затем map; src и dst могут совпадать
+    void apply(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride);
+
+    // Гистограммы всех тайлов за один проход по строкам кадра, обрезка по
+    // порогу с равномерным перераспределением излишка и LUT по CDF
+    void analyze(const uint8_t* src, size_t stride);
+
+    // Каждый пиксель - билинейная интерполяция LUT четырёх ближайших центров
+    // тайлов; LUT берутся из последнего analyze
+    void map(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride);
+
+    const Histogram& histogram(size_t tx, size_t ty) const;
+    const HistogramLut& lut(size_t tx, size_t ty) const;
+
+private:
+    // Интерполяция строки: пары LUT верхней и нижней строк тайлов и вес нижней
+    struct RowInterpolation {
+        size_t top;
+        size_t bottom;
+        uint32_t weight;
+    };
+
+    void analyze_band(const uint8_t* src, size_t stride, size_t ty);
+    void map_rows(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                  size_t begin, size_t end) const;
+    void for_ranges(size_t count, const std::function<void(size_t begin, size_t end)>& fn);
+
+    size_t width_;
+    size_t height_;
+    ClaheParams params_;
+    std::vector<size_t> tile_x_;
+    std::vector<size_t> tile_y_;
+    std::vector<Histogram> hists_;
+    std::vector<HistogramLut> luts_;
+    std::vector<uint32_t> tables_;
+    std::vector<uint32_t> pairs_;
+    std::vector<uint32_t> column_offset_;
+    std::vector<uint32_t> column_weight_;
+    std::vector<RowInterpolation> rows_;
+    std::unique_ptr<ThreadPool> pool_;
+};
@@ -1,12 +1,14 @@
 #include "histogram.h"
+#include <algorithm>
 #include <cstring>
+#include <stdexcept>
 
 #if defined(__x86_64__) || defined(_M_X64)
     #include <immintrin.h>
-    #define USE_AVX2 1
+    #define HAS_X86_KERNELS 1
 #elif defined(__aarch64__) || defined(_M_ARM64)
     #include <arm_neon.h>
-    #define USE_NEON 1
+    #define HAS_NEON_KERNEL 1
 #endif
 
 void histogram_naive(const uint8_t* data, size_t size, Histogram& hist) {
@@ -16,19 +18,205 @@ void histogram_naive(const uint8_t* data, size_t size, Histogram& hist) {
     }
 }
 
-#if defined(USE_NEON)
+// Байты достаются из регистра сдвигами 64-битных слов, без store в буфер и
+// повторной загрузки; 8 локальных гистограмм разрывают зависимость
+// load-increment-store при повторяющихся значениях
+static inline void count_word(uint32_t (&local_hist)[8][HISTOGRAM_SIZE], uint64_t word) {
+    ++local_hist[0][word & 0xff];
+    ++local_hist[1][(word >> 8) & 0xff];
+    ++local_hist[2][(word >> 16) & 0xff];
+    ++local_hist[3][(word >> 24) & 0xff];
+    ++local_hist[4][(word >> 32) & 0xff];
+    ++local_hist[5][(word >> 40) & 0xff];
+    ++local_hist[6][(word >> 48) & 0xff];
+    ++local_hist[7][word >> 56];
+}
 
-void histogram_simd(const uint8_t* data, size_t size, Histogram& hist) {
+static void histogram_scalar(const uint8_t* data, size_t size, Histogram& hist) {
+    alignas(64) uint32_t local_hist[8][HISTOGRAM_SIZE] = {};
+
+    size_t i = 0;
+    const size_t word_end = size - (size % 8);
+
+    for (; i < word_end; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        count_word(local_hist, word);
+    }
+
+    for (; i < size; ++i) {
+        ++local_hist[0][data[i]];
+    }
+
+    for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+        uint32_t total = 0;
+        for (size_t k = 0; k < 8; ++k) {
+            total += local_hist[k][j];
+        }
+        hist[j] = total;
+    }
+}
+
+// 16 гистограмм по uint16_t занимают те же 8 КиБ, что и 8 по uint32_t, но
+// вдвое реже возвращаются к одной и той же таблице: на однородных данных
+// цепочка store-load через счётчик не успевает стать узким местом. Каждая
+// группа из 16 байт добавляет ровно по единице в каждую таблицу, поэтому после
+// COMPACT_BLOCK_GROUPS групп (плюс хвост до 15 байт) счётчики сливаются в
+// 32-битный результат, не успев переполниться
+static void count_groups(CompactCounters& local_hist, const uint8_t* data, size_t groups) {
+    for (size_t g = 0; g < groups; ++g, data += 16) {
+        uint64_t low, high;
+        std::memcpy(&low, data, sizeof(low));
+        std::memcpy(&high, data + 8, sizeof(high));
+        for (size_t k = 0; k < 8; ++k) {
+            ++local_hist[k][low & 0xff];
+            ++local_hist[k + 8][high & 0xff];
+            low >>= 8;
+            high >>= 8;
+        }
+    }
+}
+
+static void spill(CompactCounters& local_hist, Histogram& hist) {
+    for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+        uint32_t total = 0;
+        for (size_t k = 0; k < COMPACT_TABLES; ++k) {
+            total += local_hist[k][j];
+        }
+        hist[j] += total;
+    }
+    std::memset(local_hist, 0, sizeof(CompactCounters));
+}
+
+static void histogram_compact(const uint8_t* data, size_t size, Histogram& hist) {
+    alignas(64) CompactCounters local_hist = {};
     std::memset(hist.data(), 0, sizeof(Histogram));
-    
+
+    size_t groups = size / 16;
+    while (groups > 0) {
+        size_t block = std::min(groups, COMPACT_BLOCK_GROUPS);
+        count_groups(local_hist, data, block);
+        data += block * 16;
+        groups -= block;
+        if (groups > 0) {
+            spill(local_hist, hist);
+        }
+    }
+
+    for (size_t i = 0; i < size % 16; ++i) {
+        ++local_hist[0][data[i]];
+    }
+    spill(local_hist, hist);
+}
+
+HistogramAccumulator::HistogramAccumulator() {
+    reset();
+}
+
+void HistogramAccumulator::reset() {
+    std::memset(local_hist_, 0, sizeof(local_hist_));
+    total_.fill(0);
+    groups_ = 0;
+    pending_size_ = 0;
+}
+
+void HistogramAccumulator::count(const uint8_t* data, size_t groups) {
+    while (groups > 0) {
+        if (groups_ == COMPACT_BLOCK_GROUPS) {
+            spill(local_hist_, total_);
+            groups_ = 0;
+        }
+        size_t block = std::min(groups, COMPACT_BLOCK_GROUPS - groups_);
+        count_groups(local_hist_, data, block);
+        data += block * 16;
+        groups -= block;
+        groups_ += block;
+    }
+}
+
+// Хвост куска короче 16 байт не считается поштучно, а ждёт начала
+// следующего куска: так группы остаются полными при любых размерах кусков
+void HistogramAccumulator::update(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (pending_size_ > 0) {
+        size_t take = std::min(size, sizeof(pending_) - pending_size_);
+        std::memcpy(pending_ + pending_size_, data, take);
+        pending_size_ += take;
+        data += take;
+        size -= take;
+        if (pending_size_ < sizeof(pending_)) {
+            return;
+        }
+        count(pending_, 1);
+        pending_size_ = 0;
+    }
+
+    count(data, size / 16);
+    pending_size_ = size % 16;
+    std::memcpy(pending_, data + size - pending_size_, pending_size_);
+}
+
+void HistogramAccumulator::merge(const HistogramAccumulator& other) {
+    for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+        uint32_t total = other.total_[j];
+        for (size_t k = 0; k < COMPACT_TABLES; ++k) {
+            total += other.local_hist_[k][j];
+        }
+        total_[j] += total;
+    }
+    update(other.pending_, other.pending_size_);
+}
+
+void HistogramAccumulator::finalize(Histogram& hist) {
+    for (size_t i = 0; i < pending_size_; ++i) {
+        ++local_hist_[0][pending_[i]];
+    }
+    spill(local_hist_, total_);
+    hist = total_;
+    reset();
+}
+
+void histogram_2d(const uint8_t* data, size_t width, size_t height, size_t stride,
+                  Histogram& hist, const HistogramRect* roi) {
+    if (stride < width) {
+        throw std::invalid_argument("histogram_2d: stride is less than width");
+    }
+
+    size_t x = 0, y = 0;
+    if (roi) {
+        x = std::min(roi->x, width);
+        y = std::min(roi->y, height);
+        width = std::min(roi->width, width - x);
+        height = std::min(roi->height, height - y);
+    }
+    data += y * stride + x;
+
+    // Строки без отступов между ними - один непрерывный буфер
+    if (width == stride || height == 1) {
+        histogram_simd(data, width * height, hist);
+        return;
+    }
+
+    HistogramAccumulator accumulator;
+    for (size_t row = 0; row < height; ++row, data += stride) {
+        accumulator.update(data, width);
+    }
+    accumulator.finalize(hist);
+}
+
+#if defined(HAS_NEON_KERNEL)
+
+static void histogram_neon(const uint8_t* data, size_t size, Histogram& hist) {
     alignas(64) uint32_t local_hist[4][HISTOGRAM_SIZE] = {};
-    
+
     size_t i = 0;
     const size_t simd_end = size - (size % 16);
-    
+
     for (; i < simd_end; i += 16) {
         uint8x16_t pixels = vld1q_u8(data + i);
-        
+
         ++local_hist[0][vgetq_lane_u8(pixels, 0)];
         ++local_hist[1][vgetq_lane_u8(pixels, 1)];
         ++local_hist[2][vgetq_lane_u8(pixels, 2)];
@@ -46,65 +234,222 @@ void histogram_simd(const uint8_t* data, size_t size, Histogram& hist) {
         ++local_hist[2][vgetq_lane_u8(pixels, 14)];
         ++local_hist[3][vgetq_lane_u8(pixels, 15)];
     }
-    
+
     for (; i < size; ++i) {
         ++local_hist[0][data[i]];
     }
-    
+
     for (size_t j = 0; j < HISTOGRAM_SIZE; j += 4) {
         uint32x4_t sum0 = vld1q_u32(&local_hist[0][j]);
         uint32x4_t sum1 = vld1q_u32(&local_hist[1][j]);
         uint32x4_t sum2 = vld1q_u32(&local_hist[2][j]);
         uint32x4_t sum3 = vld1q_u32(&local_hist[3][j]);
-        
+
         uint32x4_t total = vaddq_u32(vaddq_u32(sum0, sum1), vaddq_u32(sum2, sum3));
         vst1q_u32(&hist[j], total);
     }
 }
 
-#elif defined(USE_AVX2)
+#endif
+
+#if defined(HAS_X86_KERNELS)
+
+__attribute__((target("sse4.2")))
+static void histogram_sse42(const uint8_t* data, size_t size, Histogram& hist) {
+    alignas(64) uint32_t local_hist[8][HISTOGRAM_SIZE] = {};
+
+    size_t i = 0;
+    const size_t simd_end = size - (size % 16);
+
+    for (; i < simd_end; i += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+        count_word(local_hist, _mm_cvtsi128_si64(pixels));
+        count_word(local_hist, _mm_extract_epi64(pixels, 1));
+    }
+
+    for (; i < size; ++i) {
+        ++local_hist[0][data[i]];
+    }
+
+    for (size_t j = 0; j < HISTOGRAM_SIZE; j += 4) {
+        __m128i total = _mm_setzero_si128();
+        for (size_t k = 0; k < 8; ++k) {
+            total = _mm_add_epi32(total, _mm_load_si128(reinterpret_cast<const __m128i*>(&local_hist[k][j])));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&hist[j]), total);
+    }
+}
+
+__attribute__((target("avx2")))
+static void histogram_avx2(const uint8_t* data, size_t size, Histogram& hist) {
+    alignas(64) uint32_t local_hist[8][HISTOGRAM_SIZE] = {};
 
-void histogram_simd(const uint8_t* data, size_t size, Histogram& hist) {
-    std::memset(hist.data(), 0, sizeof(Histogram));
-    
-    alignas(64) uint32_t local_hist[4][HISTOGRAM_SIZE] = {};
-    
     size_t i = 0;
     const size_t simd_end = size - (size % 32);
-    
+
     for (; i < simd_end; i += 32) {
         __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
-        
-        alignas(32) uint8_t buffer[32];
-        _mm256_store_si256(reinterpret_cast<__m256i*>(buffer), pixels);
-        
-        for (int j = 0; j < 32; j += 4) {
-            ++local_hist[0][buffer[j]];
-            ++local_hist[1][buffer[j + 1]];
-            ++local_hist[2][buffer[j + 2]];
-            ++local_hist[3][buffer[j + 3]];
-        }
+        __m128i low = _mm256_castsi256_si128(pixels);
+        __m128i high = _mm256_extracti128_si256(pixels, 1);
+
+        count_word(local_hist, _mm_cvtsi128_si64(low));
+        count_word(local_hist, _mm_extract_epi64(low, 1));
+        count_word(local_hist, _mm_cvtsi128_si64(high));
+        count_word(local_hist, _mm_extract_epi64(high, 1));
     }
-    
+
     for (; i < size; ++i) {
         ++local_hist[0][data[i]];
     }
-    
+
     for (size_t j = 0; j < HISTOGRAM_SIZE; j += 8) {
-        __m256i sum0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&local_hist[0][j]));
-        __m256i sum1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&local_hist[1][j]));
-        __m256i sum2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&local_hist[2][j]));
-        __m256i sum3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&local_hist[3][j]));
-        
-        __m256i total = _mm256_add_epi32(_mm256_add_epi32(sum0, sum1), _mm256_add_epi32(sum2, sum3));
+        __m256i total = _mm256_setzero_si256();
+        for (size_t k = 0; k < 8; ++k) {
+            total = _mm256_add_epi32(total, _mm256_load_si256(reinterpret_cast<const __m256i*>(&local_hist[k][j])));
+        }
         _mm256_storeu_si256(reinterpret_cast<__m256i*>(&hist[j]), total);
     }
 }
 
-#else
+// Байтовое сравнение с маской (VPBROADCASTB + VPCMPEQB в k-регистр) находит
+// блоки из 64 одинаковых пикселей - фон, засветка, однородные области - и
+// считает их одним сложением вместо 64 инкрементов одного счётчика. Прочие
+// блоки идут в таблицы Compact, так что кроме одного сравнения на 64 байта
+// ядро ничего не добавляет. Хвост короче блока считается сразу в hist:
+// с ним 16-битные таблицы могли бы выйти за бюджет COMPACT_BLOCK_GROUPS
+__attribute__((target("avx512f,avx512bw")))
+static void histogram_avx512bw(const uint8_t* data, size_t size, Histogram& hist) {
+    alignas(64) CompactCounters local_hist = {};
+    std::memset(hist.data(), 0, sizeof(Histogram));
+
+    size_t i = 0, groups = 0;
+    const size_t simd_end = size - (size % 64);
 
-void histogram_simd(const uint8_t* data, size_t size, Histogram& hist) {
-    histogram_naive(data, size, hist);
+    for (; i < simd_end; i += 64) {
+        __m512i pixels = _mm512_loadu_si512(data + i);
+        __m512i first = _mm512_maskz_broadcastb_epi8(~__mmask64(0), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+        if (_mm512_cmpeq_epi8_mask(pixels, first) == ~__mmask64(0)) {
+            hist[data[i]] += 64;
+            continue;
+        }
+        if (groups + 4 > COMPACT_BLOCK_GROUPS) {
+            spill(local_hist, hist);
+            groups = 0;
+        }
+        count_groups(local_hist, data + i, 4);
+        groups += 4;
+    }
+
+    for (; i < size; ++i) {
+        ++hist[data[i]];
+    }
+    spill(local_hist, hist);
+}
+
+// 16 пикселей расширяются до 32-битных индексов; VPCONFLICTD для каждой
+// дорожки даёт маску более ранних дорожек с тем же значением, поэтому
+// 1 + popcount - сколько раз значение встретилось до этой дорожки включительно.
+// Scatter пишет дорожки по возрастанию, последний дубликат побеждает и несёт
+// полный прирост. Четыре гистограммы по очереди, чтобы gather следующего
+// шага не ждал scatter предыдущего
+__attribute__((target("avx512f,avx512cd,avx512vpopcntdq")))
+static void histogram_avx512cd(const uint8_t* data, size_t size, Histogram& hist) {
+    alignas(64) uint32_t local_hist[4][HISTOGRAM_SIZE] = {};
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i zero = _mm512_setzero_si512();
+
+    size_t i = 0;
+    const size_t simd_end = size - (size % 64);
+
+    for (; i < simd_end; i += 64) {
+        for (size_t k = 0; k < 4; ++k) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * k));
+            __m512i index = _mm512_maskz_cvtepu8_epi32(~__mmask16(0), pixels);
+            __m512i repeats = _mm512_popcnt_epi32(_mm512_conflict_epi32(index));
+            __m512i counts = _mm512_mask_i32gather_epi32(zero, ~__mmask16(0), index, local_hist[k], 4);
+            counts = _mm512_add_epi32(counts, _mm512_add_epi32(repeats, one));
+            _mm512_i32scatter_epi32(local_hist[k], index, counts, 4);
+        }
+    }
+
+    for (; i < size; ++i) {
+        ++local_hist[0][data[i]];
+    }
+
+    for (size_t j = 0; j < HISTOGRAM_SIZE; j += 16) {
+        __m512i sum0 = _mm512_load_si512(&local_hist[0][j]);
+        __m512i sum1 = _mm512_load_si512(&local_hist[1][j]);
+        __m512i sum2 = _mm512_load_si512(&local_hist[2][j]);
+        __m512i sum3 = _mm512_load_si512(&local_hist[3][j]);
+
+        __m512i total = _mm512_add_epi32(_mm512_add_epi32(sum0, sum1), _mm512_add_epi32(sum2, sum3));
+        _mm512_storeu_si512(&hist[j], total);
+    }
 }
 
 #endif
+
+// __builtin_cpu_supports проверяет и cpuid, и включённость регистров в ОС
+// (xgetbv); на aarch64 NEON входит в базовый набор и проверки не требует
+HistogramFunction histogram_kernel(HistogramKernel kernel) {
+    switch (kernel) {
+    case HistogramKernel::Scalar:
+        return histogram_scalar;
+    case HistogramKernel::Compact:
+        return histogram_compact;
+#if defined(HAS_X86_KERNELS)
+    case HistogramKernel::SSE42:
+        return __builtin_cpu_supports("sse4.2") ? histogram_sse42 : nullptr;
+    case HistogramKernel::AVX2:
+        return __builtin_cpu_supports("avx2") ? histogram_avx2 : nullptr;
+    case HistogramKernel::AVX512BW:
+        return __builtin_cpu_supports("avx512bw") ? histogram_avx512bw : nullptr;
+    case HistogramKernel::AVX512CD:
+        return __builtin_cpu_supports("avx512cd") && __builtin_cpu_supports("avx512vpopcntdq")
+                   ? histogram_avx512cd : nullptr;
+#endif
+#if defined(HAS_NEON_KERNEL)
+    case HistogramKernel::NEON:
+        return histogram_neon;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const char* histogram_kernel_name(HistogramKernel kernel) {
+    switch (kernel) {
+    case HistogramKernel::Scalar: return "Scalar";
+    case HistogramKernel::Compact: return "Compact";
+    case HistogramKernel::SSE42: return "SSE42";
+    case HistogramKernel::AVX2: return "AVX2";
+    case HistogramKernel::AVX512BW: return "AVX512BW";
+    case HistogramKernel::AVX512CD: return "AVX512CD";
+    case HistogramKernel::NEON: return "NEON";
+    }
+    return "Unknown";
+}
+
+// Извлечение байт из SIMD-регистров по скорости не отличается от 64-битных
+// загрузок, а на однородных данных всё упирается в число таблиц, поэтому
+// Compact быстрее SSE42, AVX2 и NEON везде, где их сравнивали, и эти ядра
+// доступны только явно через histogram_kernel. Автоматически выбирается
+// AVX512BW, если он есть (это Compact плюс проверка блоков из одного значения),
+// иначе Compact; VPCONFLICTD (gather/scatter) - тоже только явно
+static HistogramKernel select_kernel() {
+    if (histogram_kernel(HistogramKernel::AVX512BW)) {
+        return HistogramKernel::AVX512BW;
+    }
+    return HistogramKernel::Compact;
+}
+
+HistogramKernel histogram_active_kernel() {
+    static const HistogramKernel active = select_kernel();
+    return active;
+}
+
+void histogram_simd(const uint8_t* data, size_t size, Histogram& hist) {
+    static const HistogramFunction active = histogram_kernel(histogram_active_kernel());
+    active(data, size, hist);
+}
@@ -11,3 +11,74 @@ using Histogram = std::array<uint32_t, HISTOGRAM_SIZE>;
 void histogram_naive(const uint8_t* data, size_t size, Histogram& hist);
 
 void histogram_simd(const uint8_t* data, size_t size, Histogram& hist);
+
+// Ядра гистограммы; histogram_simd при первом вызове выбирает AVX512BW, если
+// процессор его поддерживает, иначе Compact. Остальные можно вызвать явно
+enum class HistogramKernel {
+    Scalar,
+    Compact,
+    SSE42,
+    AVX2,
+    AVX512BW,
+    AVX512CD,
+    NEON,
+};
+
+constexpr HistogramKernel HISTOGRAM_KERNELS[] = {
+    HistogramKernel::Scalar,   HistogramKernel::Compact,  HistogramKernel::SSE42,
+    HistogramKernel::AVX2,     HistogramKernel::AVX512BW, HistogramKernel::AVX512CD,
+    HistogramKernel::NEON,
+};
+
+using HistogramFunction = void (*)(const uint8_t* data, size_t size, Histogram& hist);
+
+// nullptr, если ядро не собрано для этой архитектуры или процессор его не поддерживает
+HistogramFunction histogram_kernel(HistogramKernel kernel);
+
+const char* histogram_kernel_name(HistogramKernel kernel);
+
+HistogramKernel histogram_active_kernel();
+
+constexpr size_t COMPACT_TABLES = 16;
+constexpr size_t COMPACT_BLOCK_GROUPS = 65520;
+
+using CompactCounters = uint16_t[COMPACT_TABLES][HISTOGRAM_SIZE];
+
+// Гистограмма по частям: кадры, приходящие кусками, и файлы больше памяти.
+// Между вызовами update сохраняются 16-битные локальные гистограммы ядра
+// Compact и до 15 байт хвоста последнего куска. finalize выдаёт результат
+// и сбрасывает состояние для следующего изображения
+class HistogramAccumulator {
+public:
+    HistogramAccumulator();
+
+    void update(const uint8_t* data, size_t size);
+    void merge(const HistogramAccumulator& other);
+    void finalize(Histogram& hist);
+    void reset();
+
+private:
+    void count(const uint8_t* data, size_t groups);
+
+    alignas(64) CompactCounters local_hist_;
+    Histogram total_;
+    size_t groups_;
+    uint8_t pending_[16];
+    size_t pending_size_;
+};
+
+// Прямоугольник в пикселях: левый верхний угол (x, y) и размеры
+struct HistogramRect {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+};
+
+// Гистограмма изображения width × height, строки которого идут через stride
+// байт (stride >= width, иначе std::invalid_argument). Если roi не nullptr,
+// считается только эта область, обрезанная по границам изображения. Строки
+// не копируются: идут в HistogramAccumulator, который склеивает короткие
+// строки и хвосты невыровненных в полные 16-байтовые группы
+void histogram_2d(const uint8_t* data, size_t width, size_t height, size_t stride,
+                  Histogram& hist, const HistogramRect* roi = nullptr);
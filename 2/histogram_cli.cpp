@@ -0,0 +1,380 @@
+#include "histogram.h"
+#include "image_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <glob.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Пакетный подсчёт гистограмм: histogram [опции] файл|каталог|маска ...
+// Каталоги обходятся рекурсивно (файлы .pgm и .raw), маски раскрываются
+// через glob(3), если их не раскрыл shell. Мелкие файлы раздаются пулу
+// пачками, чтобы накладные расходы на задачу не съедали выигрыш, крупные
+// режутся на куски по SLICE_BYTES и считаются параллельно. Пока считается
+// один файл пачки, для следующего уже запрошена подкачка (MADV_WILLNEED),
+// так что чтение с диска идёт одновременно с подсчётом
+
+constexpr size_t BATCH_FILES = 64;
+constexpr size_t BATCH_BYTES = 16 << 20;
+constexpr size_t SLICE_BYTES = 64 << 20;
+
+enum class OutputFormat {
+    CSV,
+    JSON,
+    Binary,
+};
+
+struct Options {
+    OutputFormat format = OutputFormat::CSV;
+    std::string output;
+    size_t threads = std::thread::hardware_concurrency();
+    std::vector<std::string> inputs;
+};
+
+struct FileResult {
+    std::string path;
+    uintmax_t file_size = 0;
+    size_t width = 0;
+    size_t height = 0;
+    Histogram hist = {};
+    std::string error;
+};
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--format csv|json|binary] [--output FILE] [--threads N] "
+            "FILE|DIR|GLOB...\n",
+            program);
+    exit(2);
+}
+
+static Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value == "csv") {
+                options.format = OutputFormat::CSV;
+            } else if (value == "json") {
+                options.format = OutputFormat::JSON;
+            } else if (value == "binary") {
+                options.format = OutputFormat::Binary;
+            } else {
+                usage(argv[0]);
+            }
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::max(1, atoi(argv[++i]));
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            usage(argv[0]);
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    if (options.inputs.empty()) {
+        usage(argv[0]);
+    }
+    options.threads = std::max<size_t>(options.threads, 1);
+    return options;
+}
+
+static bool is_image_file(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".pgm" || extension == ".raw";
+}
+
+static void add_path(const std::string& input, std::vector<std::string>& files) {
+    std::error_code error;
+    if (std::filesystem::is_directory(input, error)) {
+        std::vector<std::string> found;
+        for (auto it = std::filesystem::recursive_directory_iterator(
+                 input, std::filesystem::directory_options::skip_permission_denied, error);
+             it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (it->is_regular_file(error) && is_image_file(it->path())) {
+                found.push_back(it->path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    } else {
+        files.push_back(input);
+    }
+}
+
+static std::vector<std::string> collect_files(const std::vector<std::string>& inputs) {
+    std::vector<std::string> files;
+    for (const auto& input : inputs) {
+        bool has_pattern = input.find_first_of("*?[") != std::string::npos;
+        if (!has_pattern || std::filesystem::exists(input)) {
+            add_path(input, files);
+            continue;
+        }
+        glob_t matches;
+        if (glob(input.c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; ++i) {
+                add_path(matches.gl_pathv[i], files);
+            }
+        } else {
+            fprintf(stderr, "no matches for %s\n", input.c_str());
+        }
+        globfree(&matches);
+    }
+    return files;
+}
+
+static void process_file(FileResult& result, MappedImage& image) {
+    result.width = image.width();
+    result.height = image.height();
+    histogram_image(image, result.hist);
+}
+
+// Пачка мелких файлов в одной задаче; следующий файл отображается и
+// подкачивается заранее, пока считается текущий
+static void process_batch(std::vector<FileResult>& results, size_t begin, size_t end) {
+    std::unique_ptr<MappedImage> next;
+    auto open_next = [&](size_t index) {
+        next.reset();
+        for (; index < end; ++index) {
+            try {
+                next = std::make_unique<MappedImage>(results[index].path);
+                next->prefetch();
+                return index;
+            } catch (const std::exception& e) {
+                results[index].error = e.what();
+            }
+        }
+        return end;
+    };
+
+    size_t index = open_next(begin);
+    while (index < end) {
+        std::unique_ptr<MappedImage> current = std::move(next);
+        size_t following = open_next(index + 1);
+        process_file(results[index], *current);
+        index = following;
+    }
+}
+
+static void write_csv(FILE* out, const std::vector<FileResult>& results) {
+    fprintf(out, "path,width,height");
+    for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+        fprintf(out, ",%zu", j);
+    }
+    fprintf(out, "\n");
+    for (const auto& result : results) {
+        if (!result.error.empty()) {
+            continue;
+        }
+        // Путь в кавычках, кавычки внутри удваиваются (RFC 4180)
+        fputc('"', out);
+        for (char c : result.path) {
+            if (c == '"') {
+                fputc('"', out);
+            }
+            fputc(c, out);
+        }
+        fprintf(out, "\",%zu,%zu", result.width, result.height);
+        for (uint32_t count : result.hist) {
+            fprintf(out, ",%u", count);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static void write_json_string(FILE* out, const std::string& text) {
+    fputc('"', out);
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_json(FILE* out, const std::vector<FileResult>& results) {
+    fprintf(out, "[");
+    bool first = true;
+    for (const auto& result : results) {
+        if (!result.error.empty()) {
+            continue;
+        }
+        fprintf(out, first ? "\n  {\"path\": " : ",\n  {\"path\": ");
+        first = false;
+        write_json_string(out, result.path);
+        fprintf(out, ", \"width\": %zu, \"height\": %zu, \"histogram\": [", result.width, result.height);
+        for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+            fprintf(out, j ? ", %u" : "%u", result.hist[j]);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n]\n");
+}
+
+// Двоичный формат (порядок байт машины): "HST1", uint64 число записей,
+// затем на файл: uint32 длина пути, путь, uint64 ширина, uint64 высота,
+// 256 × uint32 счётчиков
+static void write_binary(FILE* out, const std::vector<FileResult>& results) {
+    uint64_t count = std::count_if(results.begin(), results.end(),
+                                   [](const FileResult& result) { return result.error.empty(); });
+    fwrite("HST1", 1, 4, out);
+    fwrite(&count, sizeof(count), 1, out);
+    for (const auto& result : results) {
+        if (!result.error.empty()) {
+            continue;
+        }
+        uint32_t length = result.path.size();
+        uint64_t width = result.width;
+        uint64_t height = result.height;
+        fwrite(&length, sizeof(length), 1, out);
+        fwrite(result.path.data(), 1, length, out);
+        fwrite(&width, sizeof(width), 1, out);
+        fwrite(&height, sizeof(height), 1, out);
+        fwrite(result.hist.data(), sizeof(uint32_t), HISTOGRAM_SIZE, out);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<FileResult> results;
+    for (auto& path : collect_files(options.inputs)) {
+        FileResult result;
+        result.path = std::move(path);
+        std::error_code error;
+        result.file_size = std::filesystem::file_size(result.path, error);
+        if (error) {
+            result.error = result.path + ": " + error.message();
+        }
+        results.push_back(std::move(result));
+    }
+
+    // Крупные файлы отображаются здесь и живут до конца подсчёта; их куски
+    // считаются в отдельные частичные гистограммы и складываются в конце
+    struct SlicedFile {
+        size_t index;
+        std::unique_ptr<MappedImage> image;
+        std::vector<Histogram> partial;
+    };
+    std::vector<SlicedFile> sliced;
+    std::vector<std::future<void>> futures;
+    ThreadPool pool(options.threads);
+
+    size_t batch_begin = 0;
+    size_t batch_bytes = 0;
+    auto flush_batch = [&](size_t end) {
+        if (batch_begin < end) {
+            futures.push_back(pool.submit([&results, batch_begin, end]() {
+                process_batch(results, batch_begin, end);
+            }));
+        }
+        batch_begin = end;
+        batch_bytes = 0;
+    };
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (!results[i].error.empty()) {
+            flush_batch(i);
+            batch_begin = i + 1;
+            continue;
+        }
+        if (results[i].file_size <= SLICE_BYTES) {
+            batch_bytes += results[i].file_size;
+            if (i + 1 - batch_begin >= BATCH_FILES || batch_bytes >= BATCH_BYTES) {
+                flush_batch(i + 1);
+            }
+            continue;
+        }
+        flush_batch(i);
+        batch_begin = i + 1;
+        try {
+            auto image = std::make_unique<MappedImage>(results[i].path);
+            results[i].width = image->width();
+            results[i].height = image->height();
+            size_t slices = (image->size() + SLICE_BYTES - 1) / SLICE_BYTES;
+            sliced.push_back(SlicedFile{i, std::move(image), std::vector<Histogram>(slices)});
+        } catch (const std::exception& e) {
+            results[i].error = e.what();
+        }
+    }
+    flush_batch(results.size());
+
+    for (auto& file : sliced) {
+        for (size_t s = 0; s < file.partial.size(); ++s) {
+            const uint8_t* pixels = file.image->pixels() + s * SLICE_BYTES;
+            size_t size = std::min(SLICE_BYTES, file.image->size() - s * SLICE_BYTES);
+            Histogram* partial = &file.partial[s];
+            futures.push_back(pool.submit([pixels, size, partial]() {
+                histogram_mapped(pixels, size, *partial);
+            }));
+        }
+    }
+
+    for (auto& future : futures) {
+        future.get();
+    }
+    for (auto& file : sliced) {
+        auto& hist = results[file.index].hist;
+        for (const auto& partial : file.partial) {
+            for (size_t j = 0; j < HISTOGRAM_SIZE; ++j) {
+                hist[j] += partial[j];
+            }
+        }
+    }
+
+    FILE* out = stdout;
+    if (!options.output.empty()) {
+        out = fopen(options.output.c_str(), options.format == OutputFormat::Binary ? "wb" : "w");
+        if (!out) {
+            perror(("open " + options.output).c_str());
+            return 1;
+        }
+    }
+    switch (options.format) {
+    case OutputFormat::CSV:
+        write_csv(out, results);
+        break;
+    case OutputFormat::JSON:
+        write_json(out, results);
+        break;
+    case OutputFormat::Binary:
+        write_binary(out, results);
+        break;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t processed = 0;
+    uintmax_t bytes = 0;
+    int failed = 0;
+    for (const auto& result : results) {
+        if (result.error.empty()) {
+            ++processed;
+            bytes += result.file_size;
+        } else {
+            fprintf(stderr, "%s\n", result.error.c_str());
+            ++failed;
+        }
+    }
+    fprintf(stderr, "%zu files, %.1f MB in %.3f s: %.0f files/s, %.2f GB/s (%zu threads, %s kernel)\n",
+            processed, bytes / 1e6, seconds, processed / seconds, bytes / seconds / 1e9, options.threads,
+            histogram_kernel_name(histogram_active_kernel()));
+    return failed ? 1 : 0;
+}
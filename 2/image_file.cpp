@@ -0,0 +1,178 @@
+#include "image_file.h"
+#include <algorithm>
+#include <cctype>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+// Пропускает пробелы и комментарии (# до конца строки) заголовка PGM
+static size_t skip_header_space(const uint8_t* data, size_t size, size_t pos) {
+    while (pos < size) {
+        if (data[pos] == '#') {
+            while (pos < size && data[pos] != '\n') {
+                ++pos;
+            }
+        } else if (std::isspace(data[pos])) {
+            ++pos;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+static size_t parse_header_number(const uint8_t* data, size_t size, size_t& pos, const std::string& path) {
+    pos = skip_header_space(data, size, pos);
+    if (pos >= size || !std::isdigit(data[pos])) {
+        throw std::runtime_error("malformed PGM header: " + path);
+    }
+    size_t value = 0;
+    while (pos < size && std::isdigit(data[pos])) {
+        value = value * 10 + (data[pos] - '0');
+        if (value > (size_t(1) << 32)) {
+            throw std::runtime_error("malformed PGM header: " + path);
+        }
+        ++pos;
+    }
+    return value;
+}
+
+MappedImage::MappedImage(const std::string& path, ImageFormat format)
+    : mapping_(nullptr), mapping_size_(0), pixels_(nullptr), size_(0), width_(0), height_(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "fstat " + path);
+    }
+    mapping_size_ = info.st_size;
+    if (mapping_size_ > 0) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping_ == MAP_FAILED) {
+            int error = errno;
+            mapping_ = nullptr;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "mmap " + path);
+        }
+        madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    const auto* data = static_cast<const uint8_t*>(mapping_);
+    bool is_pgm = mapping_size_ >= 2 && data[0] == 'P' && data[1] == '5';
+    if (format == ImageFormat::Auto) {
+        format = is_pgm ? ImageFormat::PGM : ImageFormat::Raw;
+    }
+
+    if (format == ImageFormat::Raw) {
+        pixels_ = data;
+        size_ = mapping_size_;
+        width_ = mapping_size_;
+        height_ = mapping_size_ > 0 ? 1 : 0;
+        return;
+    }
+
+    try {
+        if (!is_pgm) {
+            throw std::runtime_error("not a binary PGM (P5) file: " + path);
+        }
+        size_t pos = 2;
+        width_ = parse_header_number(data, mapping_size_, pos, path);
+        height_ = parse_header_number(data, mapping_size_, pos, path);
+        size_t max_value = parse_header_number(data, mapping_size_, pos, path);
+        if (max_value == 0 || max_value > 255) {
+            throw std::runtime_error("only 8-bit PGM is supported: " + path);
+        }
+        // После maxval ровно один пробельный символ, дальше пиксели
+        if (pos >= mapping_size_ || !std::isspace(data[pos])) {
+            throw std::runtime_error("malformed PGM header: " + path);
+        }
+        ++pos;
+        if (height_ != 0 && width_ > (mapping_size_ - pos) / height_) {
+            throw std::runtime_error("truncated PGM pixel data: " + path);
+        }
+        size_ = width_ * height_;
+        pixels_ = data + pos;
+    } catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+MappedImage::~MappedImage() {
+    unmap();
+}
+
+MappedImage::MappedImage(MappedImage&& other) noexcept
+    : mapping_(std::exchange(other.mapping_, nullptr)),
+      mapping_size_(std::exchange(other.mapping_size_, 0)),
+      pixels_(std::exchange(other.pixels_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      width_(std::exchange(other.width_, 0)),
+      height_(std::exchange(other.height_, 0)) {}
+
+MappedImage& MappedImage::operator=(MappedImage&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mapping_size_ = std::exchange(other.mapping_size_, 0);
+        pixels_ = std::exchange(other.pixels_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        width_ = std::exchange(other.width_, 0);
+        height_ = std::exchange(other.height_, 0);
+    }
+    return *this;
+}
+
+void MappedImage::prefetch() const {
+    if (mapping_) {
+        madvise(mapping_, mapping_size_, MADV_WILLNEED);
+    }
+}
+
+void MappedImage::unmap() {
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+}
+
+void histogram_mapped(const uint8_t* pixels, size_t size, Histogram& hist) {
+    if (size <= HISTOGRAM_FILE_WINDOW) {
+        histogram_simd(pixels, size, hist);
+        return;
+    }
+
+    // madvise требует адрес, выровненный на страницу
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    HistogramAccumulator accumulator;
+    for (size_t offset = 0; offset < size; offset += HISTOGRAM_FILE_WINDOW) {
+        size_t ahead = offset + HISTOGRAM_FILE_WINDOW;
+        if (ahead < size) {
+            uintptr_t begin = reinterpret_cast<uintptr_t>(pixels + ahead) & ~(page - 1);
+            size_t length = std::min(HISTOGRAM_FILE_WINDOW, size - ahead);
+            madvise(reinterpret_cast<void*>(begin), length, MADV_WILLNEED);
+        }
+        accumulator.update(pixels + offset, std::min(HISTOGRAM_FILE_WINDOW, size - offset));
+    }
+    accumulator.finalize(hist);
+}
+
+void histogram_image(const MappedImage& image, Histogram& hist) {
+    histogram_mapped(image.pixels(), image.size(), hist);
+}
+
+void histogram_file(const std::string& path, Histogram& hist, ImageFormat format) {
+    histogram_image(MappedImage(path, format), hist);
+}
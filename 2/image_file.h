@@ -0,0 +1,54 @@
+#pragma once
+
+#include "histogram.h"
+#include <string>
+
+enum class ImageFormat {
+    Auto,
+    Raw,
+    PGM,
+};
+
+// Файл изображения, отображённый в память только для чтения. Заголовок PGM
+// (P5) разбирается прямо в отображении, pixels() указывает на область
+// пикселей без копирования. Raw - весь файл как одна строка 8-битных пикселей,
+// Auto - PGM, если файл начинается с "P5", иначе Raw
+class MappedImage {
+public:
+    explicit MappedImage(const std::string& path, ImageFormat format = ImageFormat::Auto);
+    ~MappedImage();
+
+    MappedImage(MappedImage&& other) noexcept;
+    MappedImage& operator=(MappedImage&& other) noexcept;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+
+    const uint8_t* pixels() const { return pixels_; }
+    size_t size() const { return size_; }
+    size_t width() const { return width_; }
+    size_t height() const { return height_; }
+
+    // Просит ядро асинхронно подкачать весь файл
+    void prefetch() const;
+
+private:
+    void unmap();
+
+    void* mapping_;
+    size_t mapping_size_;
+    const uint8_t* pixels_;
+    size_t size_;
+    size_t width_;
+    size_t height_;
+};
+
+// Считает гистограмму окнами по HISTOGRAM_FILE_WINDOW байт, заранее прося
+// ядро подкачать следующее окно, пока считается текущее; pixels - любой
+// диапазон внутри отображения, например кусок большого файла
+constexpr size_t HISTOGRAM_FILE_WINDOW = 8 << 20;
+
+void histogram_mapped(const uint8_t* pixels, size_t size, Histogram& hist);
+
+void histogram_image(const MappedImage& image, Histogram& hist);
+
+void histogram_file(const std::string& path, Histogram& hist, ImageFormat format = ImageFormat::Auto);
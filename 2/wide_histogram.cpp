@@ -0,0 +1,24 @@
+#include "wide_histogram.h"
+#include <future>
+
+void wide_parallel_for(ThreadPool& pool, size_t size,
+                       const std::function<void(size_t part, size_t begin, size_t end)>& fn) {
+    size_t parts = std::max<size_t>(pool.size(), 1);
+    std::vector<std::future<void>> futures;
+    futures.reserve(parts);
+
+    for (size_t part = 0; part < parts; ++part) {
+        size_t begin = size * part / parts;
+        size_t end = size * (part + 1) / parts;
+        futures.push_back(pool.submit([&fn, part, begin, end]() {
+            fn(part, begin, end);
+        }));
+    }
+
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
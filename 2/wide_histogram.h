@@ -0,0 +1,116 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Гистограммы 10-, 12- и 16-битных изображений. Bits - значащие биты
+// пикселя (остальные отбрасываются маской, так что мусор в старших битах не
+// выводит за таблицу), Bins - число корзин, степень двойки не больше 2^Bits.
+// При Bins < 2^Bits корзины прореживаются: корзина = пиксель >> (Bits - log2 Bins)
+template <size_t Bins>
+using WideHistogram = std::array<uint32_t, Bins>;
+
+// Локальные таблицы, как в 8-битных ядрах, разрывают цепочку инкрементов
+// одного счётчика на однородных данных. До 4096 корзин четыре таблицы
+// вместе занимают 64 КиБ и почти целиком живут в L1; для 65536 корзин
+// таблица уже 256 КиБ, и берутся две, чтобы не вытеснить из L2 сами данные
+template <size_t Bins>
+constexpr size_t wide_tables() {
+    return Bins <= 4096 ? 4 : 2;
+}
+
+template <size_t Bins>
+using WideTables = std::unique_ptr<uint32_t[][Bins]>;
+
+template <unsigned Bits, size_t Bins, typename Pixel>
+void wide_count(const Pixel* data, size_t size, uint32_t (*tables)[Bins]) {
+    static_assert(std::is_unsigned_v<Pixel> && Bits <= 8 * sizeof(Pixel) && Bits <= 16);
+    static_assert(std::has_single_bit(Bins) && Bins <= (size_t(1) << Bits));
+    constexpr unsigned shift = Bits - std::countr_zero(Bins);
+    constexpr uint32_t mask = (uint32_t(1) << Bits) - 1;
+    constexpr size_t tables_count = wide_tables<Bins>();
+
+    size_t i = 0;
+    for (; i + tables_count <= size; i += tables_count) {
+        for (size_t k = 0; k < tables_count; ++k) {
+            ++tables[k][(data[i + k] & mask) >> shift];
+        }
+    }
+    for (; i < size; ++i) {
+        ++tables[0][(data[i] & mask) >> shift];
+    }
+}
+
+template <unsigned Bits, size_t Bins = size_t(1) << Bits, typename Pixel>
+void histogram_wide_naive(const Pixel* data, size_t size, WideHistogram<Bins>& hist) {
+    constexpr unsigned shift = Bits - std::countr_zero(Bins);
+    constexpr uint32_t mask = (uint32_t(1) << Bits) - 1;
+    hist.fill(0);
+    for (size_t i = 0; i < size; ++i) {
+        ++hist[(data[i] & mask) >> shift];
+    }
+}
+
+template <unsigned Bits, size_t Bins = size_t(1) << Bits, typename Pixel>
+void histogram_wide(const Pixel* data, size_t size, WideHistogram<Bins>& hist) {
+    constexpr size_t tables_count = wide_tables<Bins>();
+    WideTables<Bins> tables = std::make_unique<uint32_t[][Bins]>(tables_count);
+    wide_count<Bits, Bins>(data, size, tables.get());
+    for (size_t j = 0; j < Bins; ++j) {
+        uint32_t total = 0;
+        for (size_t k = 0; k < tables_count; ++k) {
+            total += tables[k][j];
+        }
+        hist[j] = total;
+    }
+}
+
+// Делит [0, size) на pool.size() частей и выполняет fn(part, begin, end) в
+// пуле; возвращает, когда все части готовы
+void wide_parallel_for(ThreadPool& pool, size_t size,
+                       const std::function<void(size_t part, size_t begin, size_t end)>& fn);
+
+// Каждый поток считает свой кусок в собственные таблицы (выделенные в этом же
+// потоке), затем корзины делятся между потоками и суммируются по всем таблицам.
+// Пул держит вызывающий, чтобы не создавать потоки на каждый кадр
+template <unsigned Bits, size_t Bins = size_t(1) << Bits, typename Pixel>
+void histogram_wide_parallel(const Pixel* data, size_t size, WideHistogram<Bins>& hist, ThreadPool& pool) {
+    constexpr size_t tables_count = wide_tables<Bins>();
+
+    std::vector<WideTables<Bins>> parts(std::max<size_t>(pool.size(), 1));
+    wide_parallel_for(pool, size, [&](size_t part, size_t begin, size_t end) {
+        parts[part] = std::make_unique<uint32_t[][Bins]>(tables_count);
+        wide_count<Bits, Bins>(data + begin, end - begin, parts[part].get());
+    });
+
+    wide_parallel_for(pool, Bins, [&](size_t, size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            uint32_t total = 0;
+            for (const auto& tables : parts) {
+                for (size_t k = 0; k < tables_count; ++k) {
+                    total += tables[k][j];
+                }
+            }
+            hist[j] = total;
+        }
+    });
+}
+
+// Разовый вызов: пул из num_threads потоков (0 - по числу ядер) на оба прохода
+template <unsigned Bits, size_t Bins = size_t(1) << Bits, typename Pixel>
+void histogram_wide_parallel(const Pixel* data, size_t size, WideHistogram<Bins>& hist, size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ThreadPool pool(num_threads);
+    histogram_wide_parallel<Bits, Bins>(data, size, hist, pool);
+}
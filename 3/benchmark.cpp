@@ -1,6 +1,7 @@
 #include "histogram.h"
 #include "thread_pool.h"
 #include <benchmark/benchmark.h>
+#include <memory_resource>
 #include <vector>
 #include <random>
 
@@ -110,4 +111,45 @@ static void BM_ThreadPool_Batch(benchmark::State& state) {
 }
 BENCHMARK(BM_ThreadPool_Batch)->RangeMultiplier(4)->Range(16, 4096);
 
+// Пропускная способность submit при разных memory_resource для узлов очереди:
+// 0 - по умолчанию (new/delete), 1 - monotonic, 2 - unsynchronized_pool.
+// Пул и ресурс пересоздаются вне замера, чтобы monotonic не рос бесконечно
+static std::unique_ptr<std::pmr::memory_resource> make_resource(int64_t kind) {
+    switch (kind) {
+    case 1:
+        return std::make_unique<std::pmr::monotonic_buffer_resource>();
+    case 2:
+        return std::make_unique<std::pmr::unsynchronized_pool_resource>();
+    default:
+        return nullptr;
+    }
+}
+
+static void BM_ThreadPool_Submit_Resource(benchmark::State& state) {
+    const int batch_size = 4096;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto resource = make_resource(state.range(0));
+        auto pool = std::make_unique<ThreadPool>(
+            4, resource ? resource.get() : std::pmr::get_default_resource());
+        std::vector<std::future<int>> futures;
+        futures.reserve(batch_size);
+        state.ResumeTiming();
+
+        for (int i = 0; i < batch_size; ++i) {
+            futures.push_back(pool->submit([i]() { return i * 2; }));
+        }
+        for (auto& f : futures) {
+            benchmark::DoNotOptimize(f.get());
+        }
+
+        state.PauseTiming();
+        pool.reset();
+        resource.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch_size);
+}
+BENCHMARK(BM_ThreadPool_Submit_Resource)->DenseRange(0, 2);
+
 BENCHMARK_MAIN();
@@ -1,6 +1,9 @@
 #include "thread_pool.h"
+#include <new>
 
-ThreadPool::ThreadPool(size_t num_threads) {
+ThreadPool::ThreadPool(size_t num_threads, std::pmr::memory_resource* resource)
+    : resource_(resource),
+      lock_resource_(resource != std::pmr::new_delete_resource()) {
     workers_.reserve(num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
         workers_.emplace_back(&ThreadPool::worker_thread, this);
@@ -23,18 +26,41 @@ ThreadPool::~ThreadPool() {
     Task* task = head_.load(std::memory_order_relaxed);
     while (task) {
         Task* next = task->next;
-        delete task;
+        free_task(task);
         task = next;
     }
 }
 
+ThreadPool::Task* ThreadPool::allocate_task(std::function<void()> func) {
+    std::pmr::polymorphic_allocator<Task> allocator(resource_);
+    if (!lock_resource_) {
+        return allocator.new_object<Task>(Task{std::move(func), nullptr});
+    }
+    resource_lock_.lock();
+    Task* task = allocator.allocate(1);
+    resource_lock_.unlock();
+    return new (task) Task{std::move(func), nullptr};
+}
+
+void ThreadPool::free_task(Task* task) {
+    std::pmr::polymorphic_allocator<Task> allocator(resource_);
+    if (!lock_resource_) {
+        allocator.delete_object(task);
+        return;
+    }
+    task->~Task();
+    resource_lock_.lock();
+    allocator.deallocate(task, 1);
+    resource_lock_.unlock();
+}
+
 void ThreadPool::worker_thread() {
     while (true) {
         Task* task = pop_task();
         
         if (task) {
             task->func();
-            delete task;
+            free_task(task);
             pending_tasks_.fetch_sub(1, std::memory_order_release);
         } else if (stop_.load(std::memory_order_acquire)) {
             break;
@@ -45,7 +71,7 @@ void ThreadPool::worker_thread() {
 }
 
 void ThreadPool::push_task(std::function<void()> func) {
-    Task* new_task = new Task{std::move(func), nullptr};
+    Task* new_task = allocate_task(std::move(func));
     
     pending_tasks_.fetch_add(1, std::memory_order_release);
     
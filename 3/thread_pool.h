@@ -4,6 +4,7 @@
 #include <functional>
 #include <future>
 #include <memory>
+#include <memory_resource>
 #include <thread>
 #include <vector>
 
@@ -27,12 +28,17 @@ private:
 
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency(),
+                        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     ~ThreadPool();
 
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
 
+    size_t size() const {
+        return workers_.size();
+    }
+
     template<typename Fn>
     auto submit(Fn&& f) -> std::future<decltype(f())> {
         using ReturnType = decltype(f());
@@ -56,6 +62,8 @@ private:
     void worker_thread();
     void push_task(std::function<void()> func);
     Task* pop_task();
+    Task* allocate_task(std::function<void()> func);
+    void free_task(Task* task);
 
     std::vector<std::thread> workers_;
     
@@ -65,4 +73,11 @@ private:
     
     std::atomic<bool> stop_{false};
     std::atomic<size_t> pending_tasks_{0};
+
+    // Узлы очереди выделяются из resource_. Задачи создаются и удаляются
+    // в разных потоках, а monotonic/unsynchronized_pool не потокобезопасны,
+    // поэтому всё, кроме new_delete_resource, берётся под resource_lock_
+    std::pmr::memory_resource* resource_;
+    SpinLock resource_lock_;
+    bool lock_resource_;
 };